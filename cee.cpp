@@ -6,11 +6,16 @@
 #include <otawa/etime/features.h>
 #include <otawa/ipet/features.h>
 #include <elm/sys/System.h>
+#include <elm/option/ValueOption.h>
+#include <elm/util/MessageException.h>
 #include <otawa/display/CFGOutput.h>
 #include <otawa/display/ILPSystemDisplayer.h>
 
 #include "pidcache/PIDCache.h"
 
+#include <unistd.h>
+#include <sys/wait.h>
+
 using namespace elm;
 using namespace otawa;
 
@@ -21,7 +26,13 @@ public:
 	dcache(option::SwitchOption::Make(*this).cmd("-d").cmd("--dcache").description("Perform simple data cache analysis")),
 	pcache(option::SwitchOption::Make(*this).cmd("-p").cmd("--pidcache").description("Perform PID data cache analysis")),
 	icache(option::SwitchOption::Make(*this).cmd("-i").cmd("--icache").description("Perform instruction cache analysis")),
-	wcet(option::SwitchOption::Make(*this).cmd("-w").cmd("--wcet").description("Compute the WCET"))
+	wcet(option::SwitchOption::Make(*this).cmd("-w").cmd("--wcet").description("Compute the WCET")),
+	jobs(option::ValueOption<int>::Make(*this).cmd("-j").cmd("--jobs").description("Number of threads for the PID data cache analysis").def(1)),
+	multi(option::SwitchOption::Make(*this).cmd("-m").cmd("--multi-set").description("Analyze all cache sets in one CFG traversal (PID data cache analysis)")),
+	affine(option::SwitchOption::Make(*this).cmd("-a").cmd("--affine").description("Test meeting of affine references arithmetically (PID data cache analysis)")),
+	dense(option::ValueOption<int>::Make(*this).cmd("-D").cmd("--dense").description("Use the dense engine for the cache sets with at most this number of references (PID data cache analysis)").def(0)),
+	ways(option::SwitchOption::Make(*this).cmd("-W").cmd("--ways").description("Display the statistics for every associativity up to the configured one (PID data cache analysis)")),
+	caches(option::ValueOption<string>::Make(*this).cmd("-C").cmd("--caches").description("Comma-separated list of cache configurations to analyze in turn (PID data cache analysis)").def(""))
 	{
 	}
 	
@@ -157,6 +168,182 @@ protected:
 			<< io::width(8, nc).right()
 			<< ' ' << workspace()->process()->program()->name()
 			<< io::endl;
+
+		// statistics for each associativity
+		if(ways)
+			performWaySweep(coll);
+	}
+
+	void performWaySweep(const CFGCollection& coll) {
+		int n = hard::CACHE_CONFIGURATION(workspace())->dataCache()->wayCount();
+		for(int w = 0; w < n; w++) {
+			t::uint64
+				cnt = 0,
+				ah = 0,
+				am = 0,
+				pe = 0,
+				nc = 0,
+				misses = 0;
+			bool unbounded = false;
+			for(int i = 0; i < coll.count(); i++)
+				for(CFG::BBIterator bb(coll.get(i)); bb; bb++) {
+					const Bag<pidcache::PolyAccess>& accs = pidcache::ACCESSES(bb);
+					for(int i = 0; i < accs.count(); i++) {
+						const genstruct::Vector<pidcache::way_result_t>& res = pidcache::WAY_RESULTS(accs[i]);
+						if(w >= res.length())
+							continue;
+						switch(res[w].cat) {
+						case ALWAYS_HIT:		ah++; break;
+						case ALWAYS_MISS:		am++; break;
+						case FIRST_MISS:		pe++; break;
+						case NOT_CLASSIFIED:	nc++; break;
+						default:				ASSERTP(false, accs[i].inst()->address()); break;
+						}
+						if(res[w].miss == pidcache::UNBOUNDED)
+							unbounded = true;
+						else
+							misses += res[w].miss;
+						cnt++;
+					}
+				}
+			cout
+				<< io::width(8, cnt).right()
+				<< io::width(8, ah).right()
+				<< io::width(8, am).right()
+				<< io::width(8, pe).right()
+				<< io::width(8, nc).right()
+				<< ' ' << workspace()->process()->program()->name()
+				<< " (" << (w + 1) << " way(s), ";
+			if(unbounded)
+				cout << "unbounded misses)";
+			else
+				cout << misses << " miss(es))";
+			cout << io::endl;
+		}
+	}
+
+	void performCacheSweep(PropList& props) {
+
+		// analyses not depending on the cache, shared by all configurations
+		require(pidcache::ACCESSES_FEATURE);
+
+		// get the configurations
+		genstruct::Vector<string> paths;
+		string list = *caches;
+		while(!list.isEmpty()) {
+			int i = list.indexOf(',');
+			string path = i < 0 ? list : list.substring(0, i);
+			list = i < 0 ? string("") : list.substring(i + 1);
+			if(!path.isEmpty())
+				paths.add(path);
+		}
+
+		// analyze each configuration in a child process (at most jobs at once)
+		// and display their results in order
+		int max = *jobs < 1 ? 1 : *jobs;
+		genstruct::Vector<Pair<int, int> > children;
+		int failed = 0;
+		cout.flush();
+		for(int i = 0, next = 0; i < paths.length(); i++) {
+			for(; next < paths.length() && next - i < max; next++)
+				children.add(launchConfiguration(paths[next], props));
+
+			// display the results of the oldest one
+			char buf[256];
+			int size;
+			while((size = read(children[i].snd, buf, sizeof(buf))) > 0)
+				io::out.write(buf, size);
+			close(children[i].snd);
+			int status;
+			if(waitpid(children[i].fst, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				failed++;
+		}
+		if(failed)
+			throw MessageException(_ << failed << " cache configuration(s) failed");
+	}
+
+	Pair<int, int> launchConfiguration(const string& path, PropList& props) {
+		int fds[2];
+		if(pipe(fds) < 0)
+			throw MessageException(_ << "cannot create a pipe for " << path);
+		int pid = fork();
+		if(pid < 0)
+			throw MessageException(_ << "cannot create a process for " << path);
+
+		// parent: keep the read side
+		if(pid) {
+			close(fds[1]);
+			return pair(pid, fds[0]);
+		}
+
+		// child: analyze the configuration and exit
+		close(fds[0]);
+		dup2(fds[1], 1);
+		close(fds[1]);
+		int code = 0;
+		try {
+			analyzeConfiguration(path, props);
+		}
+		catch(elm::Exception& e) {
+			cerr << "ERROR: " << path << ": " << e.message() << io::endl;
+			code = 1;
+		}
+		cout.flush();
+		cerr.flush();
+		_exit(code);
+	}
+
+	void analyzeConfiguration(const string& path, PropList& props) {
+
+		// load the configuration (replacing any previous one)
+		if(workspace()->isProvided(hard::CACHE_CONFIGURATION_FEATURE))
+			workspace()->invalidate(hard::CACHE_CONFIGURATION_FEATURE);
+		CACHE_CONFIG_PATH(props) = path;
+		pidcache::JOBS(props) = 1;
+
+		// perform analysis
+		require(pidcache::ANALYSIS_FEATURE);
+		if(wcet) {
+			require(pidcache::EVENT_FEATURE);
+			require(etime::EDGE_TIME_FEATURE);
+			require(ipet::WCET_FEATURE);
+		}
+
+		// compute statistics
+		t::uint64
+			cnt = 0,
+			ah = 0,
+			am = 0,
+			pe = 0,
+			nc = 0;
+		const CFGCollection& coll = **INVOLVED_CFGS(workspace());
+		for(int i = 0; i < coll.count(); i++)
+			for(CFG::BBIterator bb(coll.get(i)); bb; bb++) {
+				const Bag<pidcache::PolyAccess>& accs = pidcache::ACCESSES(bb);
+				for(int i = 0; i < accs.count(); i++) {
+					switch(cache::CATEGORY(accs[i])) {
+					case ALWAYS_HIT:		ah++; break;
+					case ALWAYS_MISS:		am++; break;
+					case FIRST_MISS:		pe++; break;
+					case NOT_CLASSIFIED:	nc++; break;
+					default:				ASSERTP(false, accs[i].inst()->address()); break;
+					}
+					cnt++;
+				}
+			}
+		cout
+			<< io::width(8, cnt).right()
+			<< io::width(8, ah).right()
+			<< io::width(8, am).right()
+			<< io::width(8, pe).right()
+			<< io::width(8, nc).right()
+			<< ' ' << workspace()->process()->program()->name()
+			<< " (" << path << ")";
+		if(wcet)
+			cout << " WCET = " << ipet::WCET(workspace());
+		cout << io::endl;
+		if(ways)
+			performWaySweep(coll);
 	}
 
 	void computeWCET(void) {
@@ -205,6 +392,11 @@ protected:
 		require(VIRTUALIZED_CFG_FEATURE);
 		CACHE_CONFIG_PATH(props) = "cache.xml";
 		PROCESSOR_PATH(props) = "pipeline.xml";
+		pidcache::JOBS(props) = *jobs;
+		pidcache::MULTI_SET(props) = multi;
+		pidcache::AFFINE_REF_MANAGER(props) = affine;
+		pidcache::DENSE_LIMIT(props) = *dense;
+		pidcache::WAY_SWEEP(props) = ways;
 
 		if(!quiet)
 			cout
@@ -222,8 +414,13 @@ protected:
 		if(dcache)
 			performDCacheAnalysis();
 			
-		if(pcache)
+		if(pcache) {
+			if(!(*caches).isEmpty()) {
+				performCacheSweep(props);
+				return;
+			}
 			performPIDCacheAnalysis();
+		}
 		
 		if(wcet)
 			computeWCET();
@@ -235,6 +432,12 @@ private:
 	option::SwitchOption dcache;
 	option::SwitchOption pcache;
 	option::SwitchOption wcet;
+	option::ValueOption<int> jobs;
+	option::SwitchOption multi;
+	option::SwitchOption affine;
+	option::ValueOption<int> dense;
+	option::SwitchOption ways;
+	option::ValueOption<string> caches;
 };
 
 OTAWA_RUN(CEE);
@@ -0,0 +1,65 @@
+/*
+ *	CFGInfo class -- properties of a CFG read by the parallel analyses
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef OTAWA_PIDCACHE_CFGINFO_H_
+#define OTAWA_PIDCACHE_CFGINFO_H_
+
+#include <elm/genstruct/Vector.h>
+#include <otawa/cfg.h>
+#include <otawa/util/Bag.h>
+#include "features.h"
+
+namespace otawa { namespace pidcache {
+
+using namespace elm;
+
+class CFGInfo {
+public:
+	typedef struct edge_t {
+		Edge *edge;
+		bool back;
+		BasicBlock *exit;	// header of the outermost left loop (null if not a loop exit)
+	} edge_t;
+
+	CFGInfo(CFG *cfg);
+	~CFGInfo(void);
+
+	inline CFG *cfg(void) const { return _cfg; }
+	inline const Bag<PolyAccess>& accesses(BasicBlock *bb) const { return *blocks[bb->number()].accesses; }
+	inline bool isHeader(BasicBlock *bb) const { return blocks[bb->number()].header; }
+	inline BasicBlock *enclosing(BasicBlock *bb) const { return blocks[bb->number()].enclosing; }
+	inline BasicBlock *innermost(BasicBlock *bb) const { return isHeader(bb) ? bb : enclosing(bb); }
+	inline const genstruct::Vector<edge_t>& outs(BasicBlock *bb) const { return blocks[bb->number()].outs; }
+
+private:
+	typedef struct block_t {
+		const Bag<PolyAccess> *accesses;
+		bool header;
+		BasicBlock *enclosing;
+		genstruct::Vector<edge_t> outs;
+	} block_t;
+
+	CFG *_cfg;
+	block_t *blocks;
+};
+
+} }		// otawa::pidcache
+
+#endif /* OTAWA_PIDCACHE_CFGINFO_H_ */
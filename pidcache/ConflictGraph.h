@@ -0,0 +1,81 @@
+/*
+ *	ConflictGraph class -- conflicts between the references of a CFG
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef OTAWA_PIDCACHE_CONFLICTGRAPH_H_
+#define OTAWA_PIDCACHE_CONFLICTGRAPH_H_
+
+#include <elm/genstruct/Vector.h>
+#include <elm/genstruct/HashTable.h>
+#include "PIDCache.h"
+
+namespace otawa { namespace pidcache {
+
+using namespace elm;
+
+class ConflictGraph {
+public:
+	typedef RefManager::ref_t ref_t;
+
+	static const int MEET			= 0x01;
+	static const int COMPATIBLE		= 0x02;
+	static const int SAME_BLOCKS	= 0x04;
+
+	ConflictGraph(Poly& poly, RefManager& rman);
+	~ConflictGraph(void);
+	void add(CFG *cfg);
+	void build(int jobs);
+
+	inline int count(void) const { return refs.length(); }
+	inline ref_t ref(int i) const { return refs[i]; }
+	inline int indexOf(ref_t r) const { return ids.get(r, -1); }
+	inline int degree(int i) const { return degs[i]; }
+	inline ref_t group(int i) const { return refs[reps[i]]; }
+	inline int groupCount(void) const { return groups; }
+
+	inline bool mayMeet(int i, int j) const { return i == j || (flags(i, j) & MEET); }
+	inline bool isCompatible(int i, int j) const
+		{ int f = flags(i, j); return f ? (f & COMPATIBLE) != 0 : rman.isCompatible(refs[i], refs[j]); }
+	inline bool sameBlocks(int i, int j) const { return i == j || (flags(i, j) & SAME_BLOCKS); }
+
+private:
+	typedef struct edge_t {
+		int to;
+		int flags;
+	} edge_t;
+
+	class RowTask;
+
+	void add(ref_t r);
+	int flags(int i, int j) const;
+	static bool sameTerms(ref_t r1, ref_t r2);
+
+	Poly& poly;
+	RefManager& rman;
+	genstruct::Vector<ref_t> refs;
+	genstruct::HashTable<ref_t, int> ids;
+	edge_t **rows;
+	int *degs;
+	int *reps;
+	int groups;
+};
+
+} }		// otawa::pidcache
+
+#endif /* OTAWA_PIDCACHE_CONFLICTGRAPH_H_ */
@@ -25,7 +25,10 @@
 #include <elm/int.h>
 #include <elm/io.h>
 #include <elm/genstruct/Vector.h>
+#include <elm/util/BitVector.h>
+#include <otawa/hard/Cache.h>
 #include <otawa/util/LoopInfoBuilder.h>
+#include "CFGInfo.h"
 
 namespace otawa { namespace pidcache {
 
@@ -45,12 +48,54 @@ inline void print(io::Output& out, age_t a, age_t A) {
 }
 
 
+// cache geometry known at run time
+class RuntimeGeometry {
+public:
+	typedef t::uint32 address_t;
+	inline RuntimeGeometry(const hard::Cache& cache)
+		: _ways(cache.wayCount()), _block_bits(cache.blockBits()), _set_bits(cache.setBits()) { }
+	inline age_t ways(void) const { return _ways; }
+	inline int blockBits(void) const { return _block_bits; }
+	inline int setBits(void) const { return _set_bits; }
+	inline address_t blockSize(void) const { return 1 << _block_bits; }
+	inline int setCount(void) const { return 1 << _set_bits; }
+	inline address_t block(address_t a) const { return a >> _block_bits; }
+	inline address_t set(address_t a) const { return (a >> _block_bits) & ((1 << _set_bits) - 1); }
+	inline address_t tag(address_t a) const { return a >> (_block_bits + _set_bits); }
+	inline address_t round(address_t a) const { return a & ~((1 << _block_bits) - 1); }
+private:
+	age_t _ways;
+	int _block_bits, _set_bits;
+};
+
+
+// cache geometry known at compile time
+template <int W, int B, int S>
+class StaticGeometry {
+public:
+	typedef t::uint32 address_t;
+	inline StaticGeometry(const hard::Cache& cache) { }
+	static inline bool matches(const hard::Cache& cache)
+		{ return cache.wayCount() == W && cache.blockBits() == B && cache.setBits() == S; }
+	inline age_t ways(void) const { return W; }
+	inline int blockBits(void) const { return B; }
+	inline int setBits(void) const { return S; }
+	inline address_t blockSize(void) const { return 1 << B; }
+	inline int setCount(void) const { return 1 << S; }
+	inline address_t block(address_t a) const { return a >> B; }
+	inline address_t set(address_t a) const { return (a >> B) & ((1 << S) - 1); }
+	inline address_t tag(address_t a) const { return a >> (B + S); }
+	inline address_t round(address_t a) const { return a & ~((1 << B) - 1); }
+};
+
+
 // MUST Problem
+template <class G>
 class Must {
 public:
 	typedef age_t t;
 
-	inline Must(age_t A): _A(A) { }
+	inline Must(const G& geom): _geom(geom) { }
 	inline void init(t& a) const { a = NO_AGE; }
 	inline bool equals(t a1, t a2) const { return a1 == a2; }
 
@@ -60,20 +105,23 @@ public:
 	inline void update(t& r, t a, age_t h) const
 		{ if(a <= h) r = older(a); else r = a;  }
 
-	inline void undef(t& v) const { v = _A; }
+	inline bool changes(t a, age_t h) const { return a <= h && older(a) != a; }
+
+	inline void undef(t& v) const { v = A(); }
 
-	inline void purge(t& a) const { a = _A; }
+	inline void purge(t& a) const { a = A(); }
 
 	inline void touch(t& r) const { r = 0; }
 
-	inline void print(io::Output& out, t a) const { otawa::pidcache::print(out, a, _A); }
+	inline void print(io::Output& out, t a) const { otawa::pidcache::print(out, a, A()); }
 
-	inline bool isAlive(age_t age) { return age >= 0 && age < _A; }
+	inline bool isAlive(age_t age) { return age >= 0 && age < A(); }
 
 private:
 	inline age_t older(age_t a) const
-		{ if(a == NO_AGE || a == _A) return a; else return a + 1; }
-	age_t _A;
+		{ if(a == NO_AGE || a == A()) return a; else return a + 1; }
+	inline age_t A(void) const { return _geom.ways(); }
+	G _geom;
 };
 
 
@@ -105,23 +153,47 @@ private:
 };
 
 
+// Persistence levels (stored inline): one level for the whole task
+// and one for each tracked loop, up to max_depth nested loops
+class Levels {
+public:
+	static const int max_depth = 8;
+	inline Levels(void): n(0) { }
+	inline int length(void) const { return n; }
+	inline void setLength(int length)
+		{ ASSERTP(length <= max_depth + 1, "Levels: loop nest deeper than " << max_depth); n = length; }
+	inline age_t operator[](int i) const { return a[i]; }
+	inline age_t& operator[](int i) { return a[i]; }
+private:
+	elm::t::int8 n;
+	age_t a[max_depth + 1];
+};
+
+
 // Persistence problem
+template <class G>
 class Persistence {
 public:
-	typedef genstruct::Vector<age_t> t;
+	typedef Levels t;
+
+	inline Persistence(const G& geom): _geom(geom), _scopes(0), _info(0) { }
 
-	inline Persistence(age_t A): _A(A) { }
+	// the levels are only tracked for the loops whose header is in scopes (all if null),
+	// the loops being read from info
+	inline void prune(const BitVector *scopes, const CFGInfo *info) { _scopes = scopes; _info = info; }
+	inline bool tracks(BasicBlock *header) const { return !_scopes || _scopes->bit(header->number()); }
 
 	inline void init(t& a, BasicBlock *bb) const {
 
 		// count levels
 		int cnt = 1;
-		if(LOOP_HEADER(bb))
+		if(_info->isHeader(bb) && tracks(bb))
 			cnt++;
-		BasicBlock *header = ENCLOSING_LOOP_HEADER(bb);
+		BasicBlock *header = _info->enclosing(bb);
 		while(header) {
-			cnt++;
-			header = ENCLOSING_LOOP_HEADER (header);
+			if(tracks(header))
+				cnt++;
+			header = _info->enclosing(header);
 		}
 
 		// build the value
@@ -136,7 +208,7 @@ public:
 		{ for(int i = 0; i < a.length(); i++) a[i] = NO_AGE; }
 
 	inline void purge(t& a) const
-		{ for(int i = 0; i < a.length(); i++) a[i] = _A; }
+		{ for(int i = 0; i < a.length(); i++) a[i] = A(); }
 
 	inline bool equals(const t& a1, const t& a2) const {
 		for(int i = 0; i < a1.length(); i++)
@@ -156,6 +228,13 @@ public:
 			r[i] = a[i] <= h ? older(a[i]) : a[i];
 	}
 
+	inline bool changes(const t& a, age_t h) const {
+		for(int i = 0; i < a.length(); i++)
+			if(a[i] <= h && older(a[i]) != a[i])
+				return true;
+		return false;
+	}
+
 	inline void touch(t& a) const {
 		for(int i = 0; i < a.length(); i++)
 			a[i] = 0;
@@ -163,7 +242,7 @@ public:
 
 	inline void print(io::Output& out, const t& a) {
 		for(int i = 0; i < a.length(); i++)
-			otawa::pidcache::print(out, a[i], _A);
+			otawa::pidcache::print(out, a[i], A());
 	}
 
 	inline void enter(t& r, const t& a) {
@@ -181,14 +260,17 @@ public:
 			r[i - 1] = a[i];
 	}
 
-	inline bool isAlive(const t& a) const { return a[0] >= 0 && a[0] < _A; }
+	inline bool isAlive(const t& a) const { return a[0] >= 0 && a[0] < A(); }
 
 private:
 	inline age_t join(age_t a1, age_t a2) const { return max(a1, a2); }
 
 	inline age_t older(age_t a) const
-		{ if(a == NO_AGE || a == _A) return a; else return a + 1; }
-	age_t _A;
+		{ if(a == NO_AGE || a == A()) return a; else return a + 1; }
+	inline age_t A(void) const { return _geom.ways(); }
+	G _geom;
+	const BitVector *_scopes;
+	const CFGInfo *_info;
 };
 
 } }		// otawa::pidcache
@@ -22,14 +22,16 @@
 #define OTAWA_DCACHE_PIDCACHE_H_
 
 #include <elm/genstruct/Table.h>
+#include <elm/genstruct/HashTable.h>
+#include <elm/util/BitVector.h>
 #include <otawa/base.h>
 #include <elm/type_info.h>
 #include <otawa/hard/CacheConfiguration.h>
 #include <otawa/util/FlowFactLoader.h>
 #include <otawa/util/Bag.h>
+#include <otawa/cache/categories.h>
 #include "PolyAnalysis.h"
 #include "features.h"
-#include <otawa/util/Dominance.h>
 
 namespace otawa { namespace pidcache {
 
@@ -41,10 +43,13 @@ public:
 	typedef Poly::t ref_t;
 	typedef t::uint32 address_t;
 
-	inline RefManager(const hard::Cache& cache): _cache(cache) { }
+	inline RefManager(const hard::Cache& cache, const Poly& poly): _cache(cache), _poly(poly) { }
 	virtual ~RefManager(void);
 	inline const hard::Cache& cache(void) const { return _cache; }
+	inline const Poly& poly(void) const { return _poly; }
 	bool isCompatible(ref_t rr, ref_t tr);
+	void index(ref_t r);
+	int blockSpan(ref_t r);
 
 	virtual bool concerns(ref_t r, unsigned int set) = 0;
 	virtual bool mayMeet(ref_t r1, int gen1, ref_t r2, int gen2) = 0;
@@ -54,7 +59,7 @@ public:
 
 	class RefIter: public PreIterator<RefIter, address_t> {
 	public:
-		RefIter(ref_t r);
+		RefIter(const Poly& poly, ref_t r);
 		inline bool ended(void) const { return e; }
 		inline address_t item(void) const { return addr; }
 		inline bool failed(void) const { return _failed; }
@@ -67,7 +72,7 @@ public:
 			int i;
 			int m;
 			Poly::coef_t c;
-			BasicBlock *h;
+			Poly::header_t h;
 		} steps[max];
 		int u;
 		bool e;
@@ -77,7 +82,7 @@ public:
 
 	class CoRefIter: public PreIterator<CoRefIter, Pair<address_t, address_t> > {
 	public:
-		CoRefIter(ref_t r1, ref_t r2);
+		CoRefIter(const Poly& poly, ref_t r1, ref_t r2);
 		Pair<address_t, address_t> item(void) const { return ap; }
 		inline bool ended(void) const { return e; }
 		inline bool failed(void) const { return _failed; }
@@ -89,7 +94,7 @@ public:
 			int i;
 			int m;
 			Poly::coef_t c1, c2;
-			BasicBlock *h;
+			Poly::header_t h;
 		} steps[max];
 		int u;
 		bool _failed;
@@ -97,8 +102,20 @@ public:
 		Pair<address_t, address_t> ap;
 	};
 
+protected:
+	typedef struct info_t {
+		inline info_t(int set_count): sets(set_count), base(0), top(0), blocks(0) { }
+		BitVector sets;
+		address_t base, top;
+		int blocks;
+	} info_t;
+	inline const info_t *info(ref_t r) const { return infos.get(r, 0); }
+	void coverage(ref_t r, BitVector& sets);
+
 private:
 	const hard::Cache& _cache;
+	const Poly& _poly;
+	genstruct::HashTable<ref_t, info_t *> infos;
 };
 
 
@@ -108,6 +125,7 @@ extern Identifier<Bag<PolyAccess> > ACCESSES;
 
 extern p::feature REF_MANAGER_FEATURE;
 extern Identifier<RefManager *> REF_MANAGER;
+extern Identifier<bool> AFFINE_REF_MANAGER;
 
 extern p::feature ANALYSIS_FEATURE;
 typedef t::uint64 miss_count_t;
@@ -129,6 +147,17 @@ typedef struct stat_t {
 } stat_t;
 
 extern Identifier<stat_t> STAT;
+extern Identifier<int> JOBS;
+extern Identifier<bool> MULTI_SET;
+extern Identifier<int> DENSE_LIMIT;
+extern Identifier<bool> WAY_SWEEP;
+
+typedef struct way_result_t {
+	inline way_result_t(void): cat(cache::INVALID_CATEGORY), miss(0) { }
+	cache::category_t cat;
+	miss_count_t miss;
+} way_result_t;
+extern Identifier<genstruct::Vector<way_result_t> > WAY_RESULTS;
 
 extern p::feature EVENT_FEATURE;
 
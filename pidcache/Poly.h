@@ -23,7 +23,11 @@
 
 #include <elm/types.h>
 #include <elm/alloc/StackAllocator.h>
+#include <elm/sys/Thread.h>
+#include <elm/genstruct/HashTable.h>
 #include <otawa/cfg/BasicBlock.h>
+#include <otawa/cfg/CFG.h>
+#include <otawa/cfg/features.h>
 
 namespace otawa { namespace pidcache {
 
@@ -34,19 +38,29 @@ public:
 	static const int cap = 8;
 	typedef t::uint32 address_t;
 	typedef t::int32 coef_t;
+	typedef t::uint32 header_t;
 	class pair_t {
 	public:
 		coef_t c;
-		BasicBlock *h;
+		header_t h;
 		inline pair_t(void): c(0), h(0) { }
-		inline pair_t(coef_t _c, BasicBlock *_h): c(_c), h(_h) { }
+		inline pair_t(coef_t _c, header_t _h): c(_c), h(_h) { }
 		inline bool operator==(const pair_t& v) const { return h == v.h && c == v.c; }
 		inline bool operator!=(const pair_t& v) const { return h == v.h && c == v.c; }
 	};
 	typedef pair_t *t;
 	static pair_t top[], bot[];
 
-	inline Poly(StackAllocator& alloc): allocator(alloc) { }
+	Poly(StackAllocator& alloc);
+	~Poly(void);
+
+	void setLoops(const CFGCollection& coll);
+	inline header_t header(BasicBlock *bb) const { return heads.get(bb, 0); }
+	inline BasicBlock *block(header_t h) const { return loops[h].bb; }
+	inline int maxIteration(header_t h) const { return loops[h].max; }
+	inline int minIteration(header_t h) const { return loops[h].min; }
+	inline bool precedes(header_t h1, header_t h2) const
+		{ return loops[h1].order < loops[h2].order; }
 
 	bool toAddress(t v, address_t& base, address_t& top, ot::size& off);
 	bool isTopPrecise(t v);
@@ -72,7 +86,7 @@ public:
 	inline t umul(t p1, t p2) { return top; }
 	inline t udiv(t p1, t p2) { return top; }
 	inline t umod(t p1, t p2) { return top; }
-	bool equals(t p1, t p2) const;
+	inline bool equals(t p1, t p2) const { return p1 == p2; }
 	t join(t p1, t p2);
 	t loop_join(BasicBlock *h, t in, t back);
 	t widen(BasicBlock *h, t prev, t next);
@@ -85,11 +99,32 @@ public:
 	void dump(io::Output& out, t p) const;
 
 private:
-	inline t allocate(int n = cap) { return t(allocator.allocate(sizeof(pair_t) * n)); }
+	typedef struct loop_t {
+		BasicBlock *bb;
+		int order;
+		int max, min;
+	} loop_t;
+
+	typedef struct node_t {
+		node_t *next;
+		elm::t::uint32 hash;
+		t val;
+	} node_t;
+
+	Poly(const Poly& poly);
+	static inline int length(t v) { return v[-1].c; }
+	t intern(const pair_t *v);
+	static elm::t::uint32 hash(const pair_t *v);
+	bool same(t p1, t p2) const;
 	coef_t looselyAdd(coef_t v1, coef_t v2, bool& lost);
 	coef_t looselyShl(coef_t v, coef_t shift, bool& lost);
 	coef_t looselyMul(coef_t v1, coef_t v2, bool & lost);
 	StackAllocator& allocator;
+	sys::Mutex *mutex;
+	node_t **htab;
+	int hsize, hcount;
+	loop_t *loops;
+	genstruct::HashTable<BasicBlock *, header_t> heads;
 };
 
 extern Identifier<Poly::pair_t *> POLY_TOP;
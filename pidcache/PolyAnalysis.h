@@ -45,7 +45,7 @@ private:
 
 public:
 
-	PolyManager(WorkSpace *ws, CFG *cfg);
+	PolyManager(WorkSpace *ws);
 	~PolyManager(void) { delete [] tmps; }
 	inline dfa::FastState<Poly>& state(void) { return _state; }
 	inline Poly& poly(void) { return _poly; }
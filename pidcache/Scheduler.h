@@ -0,0 +1,57 @@
+/*
+ *	Scheduler class -- work-stealing task scheduler
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef OTAWA_PIDCACHE_SCHEDULER_H_
+#define OTAWA_PIDCACHE_SCHEDULER_H_
+
+#include <elm/genstruct/Vector.h>
+#include <elm/sys/Thread.h>
+
+namespace otawa { namespace pidcache {
+
+using namespace elm;
+
+class Scheduler {
+public:
+
+	class Task {
+	public:
+		virtual ~Task(void);
+		virtual void run(void) = 0;
+	};
+
+	Scheduler(int jobs);
+	~Scheduler(void);
+	inline int jobs(void) const { return _jobs; }
+	void add(Task *task);
+	void run(void);
+
+private:
+	class Worker;
+	Task *steal(Worker *thief);
+
+	int _jobs;
+	genstruct::Vector<Task *> tasks;
+	genstruct::Vector<Worker *> workers;
+};
+
+} }		// otawa::pidcache
+
+#endif /* OTAWA_PIDCACHE_SCHEDULER_H_ */
@@ -0,0 +1,106 @@
+/*
+ *	pidcache::CFGInfo class
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <otawa/cfg/features.h>
+#include <otawa/util/LoopInfoBuilder.h>
+#include "CFGInfo.h"
+
+namespace otawa { namespace pidcache {
+
+/**
+ * @class CFGInfo
+ * Properties of the blocks and edges of a CFG used by the cache analyses
+ * (accesses, loop headers and loop edges), copied into plain arrays
+ * indexed by block number.
+ *
+ * Looking for a property in a PropList moves it to the head of the list:
+ * the analyses running in parallel on the same CFG must not read the
+ * properties themselves. The information is extracted once before they
+ * are launched and is then only read.
+ */
+
+
+/**
+ * Extract the information of a CFG.
+ * @param cfg	CFG to extract information of.
+ */
+CFGInfo::CFGInfo(CFG *cfg): _cfg(cfg), blocks(new block_t[cfg->countBB()]) {
+	for(CFG::BBIterator bb(cfg); bb; bb++) {
+		block_t& b = blocks[bb->number()];
+		const Bag<PolyAccess>& accesses = *ACCESSES(bb);
+		b.accesses = &accesses;
+		b.header = LOOP_HEADER(bb);
+		b.enclosing = ENCLOSING_LOOP_HEADER(bb);
+		for(BasicBlock::OutIterator out(bb); out; out++) {
+			edge_t e;
+			e.edge = out;
+			e.back = BACK_EDGE(out);
+			e.exit = LOOP_EXIT_EDGE(out);
+			b.outs.add(e);
+		}
+	}
+}
+
+
+/**
+ */
+CFGInfo::~CFGInfo(void) {
+	delete [] blocks;
+}
+
+
+/**
+ * @fn const Bag<PolyAccess>& CFGInfo::accesses(BasicBlock *bb) const;
+ * Get the accesses of a block (@ref ACCESSES).
+ * @param bb	Looked block.
+ * @return		Accesses of the block.
+ */
+
+/**
+ * @fn bool CFGInfo::isHeader(BasicBlock *bb) const;
+ * Test if a block is a loop header (@ref LOOP_HEADER).
+ * @param bb	Tested block.
+ * @return		True if it is a loop header, false else.
+ */
+
+/**
+ * @fn BasicBlock *CFGInfo::enclosing(BasicBlock *bb) const;
+ * Get the header of the loop enclosing a block (@ref ENCLOSING_LOOP_HEADER).
+ * @param bb	Looked block.
+ * @return		Enclosing loop header or null.
+ */
+
+/**
+ * @fn BasicBlock *CFGInfo::innermost(BasicBlock *bb) const;
+ * Get the header of the innermost loop containing a block.
+ * @param bb	Looked block.
+ * @return		The block itself if it is a loop header, else its enclosing loop header (null if none).
+ */
+
+/**
+ * @fn const genstruct::Vector<CFGInfo::edge_t>& CFGInfo::outs(BasicBlock *bb) const;
+ * Get the output edges of a block, in the order of BasicBlock::OutIterator,
+ * with their loop properties (@ref BACK_EDGE, @ref LOOP_EXIT_EDGE).
+ * @param bb	Looked block.
+ * @return		Output edges.
+ */
+
+} }	// otawa::pidcache
@@ -0,0 +1,299 @@
+/*
+ *	pidcache::ConflictGraph class
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <otawa/cfg/features.h>
+#include "ConflictGraph.h"
+#include "Scheduler.h"
+
+namespace otawa { namespace pidcache {
+
+/**
+ * @class ConflictGraph
+ * Relations between the references accessed by a CFG, as stored in the
+ * abstract cache states: the accessed references and the constant references
+ * produced at loop exit (constant ones being rounded to their block).
+ *
+ * For each pair of distinct references, the graph records if they may meet
+ * (@ref RefManager::mayMeet()), if the first is compatible with the second
+ * (@ref RefManager::isCompatible()) and if they always access the same blocks
+ * (@ref RefManager::sameBlocks()). As most references do not meet, only the
+ * meeting pairs are stored, in rows sorted by index: the same-block relation
+ * is only computed for them.
+ *
+ * The references with the same loop terms always accessing the same blocks
+ * on the whole iteration space are grouped: the analyses use the first
+ * reference of the group in place of the others, so that the group is
+ * represented by only one node in the abstract cache states. For example,
+ * two fields s[i].x and s[i].y of an array of block-sized and block-aligned
+ * structures are grouped. a[i] and a[i+1] are not as soon as the element
+ * size is smaller than the block size: some iterations straddle two blocks.
+ *
+ * The graph is built once, before the analyses, and is then only read:
+ * it may be shared by analyses running in parallel.
+ */
+
+
+// computation of the rows of the graph
+class ConflictGraph::RowTask: public Scheduler::Task {
+public:
+	typedef struct pair_t {
+		int from;
+		edge_t edge;
+	} pair_t;
+
+	inline RowTask(ConflictGraph& graph, int first, int step)
+		: g(graph), _first(first), _step(step) { }
+
+	virtual void run(void) {
+		for(int i = _first; i < g.refs.length(); i += _step)
+			for(int j = i + 1; j < g.refs.length(); j++)
+				if(g.rman.mayMeet(g.refs[i], 0, g.refs[j], 0)) {
+					int same = g.rman.sameBlocks(g.refs[i], g.refs[j]) ? SAME_BLOCKS : 0;
+					pair_t p;
+					p.from = i;
+					p.edge.to = j;
+					p.edge.flags = MEET | same | (g.rman.isCompatible(g.refs[i], g.refs[j]) ? COMPATIBLE : 0);
+					edges.add(p);
+					p.from = j;
+					p.edge.to = i;
+					p.edge.flags = MEET | same | (g.rman.isCompatible(g.refs[j], g.refs[i]) ? COMPATIBLE : 0);
+					edges.add(p);
+				}
+	}
+
+	genstruct::Vector<pair_t> edges;
+
+private:
+	ConflictGraph& g;
+	int _first, _step;
+};
+
+
+/**
+ * Build an empty conflict graph.
+ * @param poly	Poly domain (to build the normalized references).
+ * @param rman	Reference manager.
+ */
+ConflictGraph::ConflictGraph(Poly& _poly, RefManager& _rman)
+: poly(_poly), rman(_rman), rows(0), degs(0), reps(0), groups(0) {
+}
+
+
+/**
+ */
+ConflictGraph::~ConflictGraph(void) {
+	if(rows)
+		for(int i = 0; i < refs.length(); i++)
+			delete [] rows[i];
+	delete [] rows;
+	delete [] degs;
+	delete [] reps;
+}
+
+
+/**
+ * Add the references of the accesses of a CFG to the graph.
+ * Must be called before @ref build().
+ * @param cfg	CFG to add references of.
+ */
+void ConflictGraph::add(CFG *cfg) {
+	ASSERT(!rows);
+	for(CFG::BBIterator bb(cfg); bb; bb++) {
+		const Bag<PolyAccess>& accesses = *ACCESSES(bb);
+		for(int i = 0; i < accesses.count(); i++) {
+			ref_t r = accesses[i].ref();
+			if(!accesses[i].cached() || r == poly.bot || r == poly.top)
+				continue;
+
+			// reference as stored in the ACS
+			if(r->h)
+				add(r);
+			else
+				add(poly.make(Poly::coef_t(RefManager::address_t(r->c) & ~(rman.cache().blockSize() - 1))));
+
+			// last value at loop exit (rounded to its block)
+			Poly::address_t base, top;
+			ot::size off;
+			if(r->h && poly.toAddress(r, base, top, off) && poly.isTopPrecise(r))
+				add(poly.make(Poly::coef_t((top - off) & ~(rman.cache().blockSize() - 1))));
+		}
+	}
+}
+
+
+/**
+ * Add a reference to the graph if not already present.
+ * @param r		Added reference.
+ */
+void ConflictGraph::add(ref_t r) {
+	if(ids.hasKey(r))
+		return;
+	ids.put(r, refs.length());
+	refs.add(r);
+}
+
+
+/**
+ * Compute the relations between the added references.
+ * The references must have been indexed in the reference manager.
+ * @param jobs	Number of threads to use.
+ */
+void ConflictGraph::build(int jobs) {
+	int n = refs.length();
+
+	// compute the edges in parallel (rows interleaved for balance)
+	Scheduler sched(jobs);
+	int m = min(n, sched.jobs() * 8);
+	genstruct::Vector<RowTask *> tasks;
+	for(int i = 0; i < m; i++) {
+		tasks.add(new RowTask(*this, i, m));
+		sched.add(tasks[i]);
+	}
+	try {
+		sched.run();
+	}
+	catch(...) {
+		for(int i = 0; i < tasks.length(); i++)
+			delete tasks[i];
+		throw;
+	}
+
+	// allocate the rows
+	degs = new int[n];
+	rows = new edge_t *[n];
+	for(int i = 0; i < n; i++)
+		degs[i] = 0;
+	for(int i = 0; i < tasks.length(); i++)
+		for(int j = 0; j < tasks[i]->edges.length(); j++)
+			degs[tasks[i]->edges[j].from]++;
+	for(int i = 0; i < n; i++) {
+		rows[i] = degs[i] ? new edge_t[degs[i]] : 0;
+		degs[i] = 0;
+	}
+
+	// fill and sort the rows
+	for(int i = 0; i < tasks.length(); i++) {
+		for(int j = 0; j < tasks[i]->edges.length(); j++) {
+			const RowTask::pair_t& p = tasks[i]->edges[j];
+			rows[p.from][degs[p.from]++] = p.edge;
+		}
+		delete tasks[i];
+	}
+	for(int i = 0; i < n; i++)
+		for(int j = 1; j < degs[i]; j++)
+			for(int k = j; k > 0 && rows[i][k].to < rows[i][k - 1].to; k--) {
+				edge_t e = rows[i][k];
+				rows[i][k] = rows[i][k - 1];
+				rows[i][k - 1] = e;
+			}
+
+	// group the references (same blocks is transitive: the first of a group is found in the row)
+	reps = new int[n];
+	for(int i = 0; i < n; i++) {
+		reps[i] = i;
+		if(refs[i]->h)
+			for(int k = 0; k < degs[i] && rows[i][k].to < i; k++)
+				if((rows[i][k].flags & SAME_BLOCKS) && sameTerms(refs[i], refs[rows[i][k].to])) {
+					reps[i] = reps[rows[i][k].to];
+					break;
+				}
+		if(reps[i] == i)
+			groups++;
+	}
+}
+
+
+/**
+ * Test if two references have the same loop terms (their constants may differ).
+ * @param r1	First reference.
+ * @param r2	Second reference.
+ * @return		True if they have the same loop terms, false else.
+ */
+bool ConflictGraph::sameTerms(ref_t r1, ref_t r2) {
+	for(; r1->h && r2->h; r1++, r2++)
+		if(r1->h != r2->h || r1->c != r2->c)
+			return false;
+	return !r1->h && !r2->h;
+}
+
+
+/**
+ * Get the relation flags between two references.
+ * @param i		Index of the first reference.
+ * @param j		Index of the second reference.
+ * @return		Flags (@ref MEET, @ref COMPATIBLE, @ref SAME_BLOCKS) or 0 if they do not meet.
+ */
+int ConflictGraph::flags(int i, int j) const {
+	const edge_t *row = rows[i];
+	int lo = 0, hi = degs[i];
+	while(lo < hi) {
+		int m = (lo + hi) / 2;
+		if(row[m].to == j)
+			return row[m].flags;
+		else if(row[m].to < j)
+			lo = m + 1;
+		else
+			hi = m;
+	}
+	return 0;
+}
+
+
+/**
+ * @fn int ConflictGraph::indexOf(ref_t r) const;
+ * Get the index of a reference in the graph.
+ * @param r		Looked reference.
+ * @return		Reference index or -1 if it is not in the graph.
+ */
+
+/**
+ * @fn ref_t ConflictGraph::group(int i) const;
+ * Get the reference representing the group of a reference.
+ * @param i		Index of the reference.
+ * @return		Representative reference (the reference itself if it is not grouped).
+ */
+
+/**
+ * @fn bool ConflictGraph::mayMeet(int i, int j) const;
+ * Test if two references may access the same block.
+ * @param i		Index of the first reference.
+ * @param j		Index of the second reference.
+ * @return		True if they may meet, false else.
+ */
+
+/**
+ * @fn bool ConflictGraph::isCompatible(int i, int j) const;
+ * Test if the headers of the second reference are included in the headers of the first one.
+ * @param i		Index of the first reference.
+ * @param j		Index of the second reference.
+ * @return		True if compatible, false else.
+ */
+
+/**
+ * @fn bool ConflictGraph::sameBlocks(int i, int j) const;
+ * Test if two references always access the same blocks. Only recorded for
+ * meeting references.
+ * @param i		Index of the first reference.
+ * @param j		Index of the second reference.
+ * @return		True if they access the same blocks, false else.
+ */
+
+} }	// otawa::pidcache
@@ -19,7 +19,10 @@
  *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <string.h>
+#include <elm/genstruct/HashTable.h>
 #include <otawa/proc/BBProcessor.h>
+#include <otawa/cfg/features.h>
 #include <otawa/hard/CacheConfiguration.h>
 #include <otawa/util/LoopInfoBuilder.h>
 #include <otawa/util/FlowFactLoader.h>
@@ -29,11 +32,15 @@
 
 #include "PIDCache.h"
 #include "PIDAnalysis.h"
+#include "Scheduler.h"
+#include "ConflictGraph.h"
+#include "CFGInfo.h"
 
 //#define WITH_GEN(t)
 
 #define QDCACHE_DEBUG(t)	//t
 // #define QDCACHE_CHECK
+// #define DENSE_CHECK		// compare the results of the dense engine with the list engine
 
 #	ifdef QDCACHE_CHECK
 #		define QDCACHE_DO_CHECK(s) \
@@ -52,9 +59,54 @@ Identifier<stat_t> STAT("otawa::pidcache::STAT");
 
 
 /**
- * Non-optimized version!
+ * Result of the analysis of one access for one cache set.
+ * Collected by each (CFG, set) analysis and merged afterwards
+ * in the set order on the accesses.
  */
-class PIDManager {
+typedef struct result_t {
+	inline result_t(void): miss(0), cat(cache::INVALID_CATEGORY) { }
+	miss_count_t miss;
+	stat_t stat;
+	cache::category_t cat;
+} result_t;
+
+
+/**
+ * Counters of the join memoization of the ACS managers.
+ */
+typedef struct join_stat_t {
+	inline join_stat_t(void): hits(0), misses(0) { }
+	inline join_stat_t& operator+=(const join_stat_t& s) { hits += s.hits; misses += s.misses; return *this; }
+	int hits, misses;
+} join_stat_t;
+
+
+/**
+ * Statistics of the lengths of the ACS computed for a cache set.
+ */
+typedef struct acs_stat_t {
+	inline acs_stat_t(void): states(0), total(0), max(0) { }
+	inline void add(int length) { states++; total += length; if(length > max) max = length; }
+	inline float average(void) const { return states ? float(total) / states : 0; }
+	int states;
+	elm::t::int64 total;
+	int max;
+} acs_stat_t;
+
+
+/**
+ * Manager of the abstract cache states (ACS) of one cache set.
+ * The states are hash-consed: a state is a list of unique nodes whose
+ * tail is itself unique, so that structurally equal states are the same
+ * object and their equality is a pointer comparison.
+ *
+ * The manager is parametrized by the cache geometry G (RuntimeGeometry or
+ * StaticGeometry): with a static geometry, the associativity and the
+ * address to set and tag computations are compile-time constants.
+ */
+template <class G>
+class BasicPIDManager {
+	friend class DenseManager;
 public:
 	typedef Poly::t ref_t;
 
@@ -62,23 +114,27 @@ private:
 
 	class Node {
 	public:
-		inline Node(void): next(0), ref(0), must(NO_AGE), gen(0) { }
-		inline Node(ref_t _ref): next(0), ref(_ref), must(NO_AGE), gen(0) { }
-		inline Node(Node *node): next(0), ref(node->ref), must(node->must), gen(node->gen)
+		inline Node(void): next(0), hnext(0), hash(0), unique(false), ref(0), id(-1), gen(0), must(NO_AGE) { }
+		inline Node(ref_t _ref, int _id): next(0), hnext(0), hash(0), unique(false), ref(_ref), id(_id), gen(0), must(NO_AGE) { }
+		inline Node(Node *node): next(0), hnext(0), hash(0), unique(false), ref(node->ref), id(node->id), gen(node->gen), must(node->must)
 			{ 	pers = node->pers; }
 		inline void *operator new(size_t s, StackAllocator& alloc) { return alloc.allocate<Node>(); }
 
 		Node *next;
+		Node *hnext;
+		elm::t::uint32 hash;
+		bool unique;
 		ref_t ref;
+		int id;			// index of ref in the conflict graph (-1 if none)
 		int gen;
-		Must::t must;
-		Persistence::t pers;
+		age_t must;
+		Levels pers;
 	};
 
 	inline Node *make(Node *n) { return new(alloc) Node(n); }
 
 	Node *make(ref_t ref, BasicBlock *bb) {
-		Node *n = new(alloc) Node(ref);
+		Node *n = new(alloc) Node(ref, indexOf(ref));
 		n->must = 0;
 		pers.init(n->pers, bb);
 		return n;
@@ -87,39 +143,80 @@ private:
 public:
 	typedef Node *t;
 
-	PIDManager(int _set, Poly& _pman, RefManager& _rman)
-		:	cache(&_rman.cache()),
+	BasicPIDManager(int _set, Poly& _pman, RefManager& _rman, const ConflictGraph *_conflicts = 0)
+		:	geom(_rman.cache()),
 		 	set(_set),
-		 	A(_rman.cache().wayCount()),
 		 	_bot(&bot_node),
 		 	_top(0),
 		 	poly(_pman),
 		 	rman(_rman),
-		 	must(A),
-		 	pers(A) { 
+		 	conflicts(_conflicts),
+		 	must(geom),
+		 	pers(geom),
+		 	acc(0),
+		 	htab(new Node *[256]),
+		 	hsize(256),
+		 	hcount(0),
+		 	scopes(0),
+		 	sums(0),
+		 	sweep(false) {
+			for(int i = 0; i < hsize; i++)
+				htab[i] = 0;
+			for(int i = 0; i < memo_size; i++)
+				memo[i].s1 = memo[i].s2 = memo[i].r = _bot;
 		}
 
+	~BasicPIDManager(void) { delete [] acc; delete [] htab; delete scopes; delete [] sums; }
+
 	inline t bot(void) const { return _bot; }
 	inline t init(void) const { return _top; }
 
-	bool equals(t s1, t s2) {
-		//cerr << "EQUALS(\n"; dump(cerr, s1); dump(cerr, s2); cerr << ") = ";
-		if(s1 != _bot && s2 != _bot)
-			while(s1 != s2) {
-				if(!s1
-				|| !s2
-				|| !poly.equals(s1->ref, s2->ref)
-				|| s1->gen != s2->gen
-				|| !must.equals(s1->must, s2->must)
-				|| !pers.equals(s1->pers, s2->pers)) {
-					//cerr << "false\n";
-					return false;
+	inline bool equals(t s1, t s2) const { return s1 == s2; }
+
+	/**
+	 * Restrict the persistence levels to the loops able to classify
+	 * an access of the set. The persistence of a loop is only looked
+	 * at by the accesses whose innermost loop is this one: when the loop
+	 * is left, its level is replaced by the one of the outer loop.
+	 * As the levels of a node are ordered (inner ages are never older than
+	 * outer ones), the levels of the other loops have no effect on
+	 * the results. The outermost level (whole task) is always kept.
+	 *
+	 * The summaries of the blocks for the set are also built: the ordered
+	 * accesses of the block updating the set with their normalized reference.
+	 * An access to the same reference as the previous access of the summary
+	 * is coalesced with it: as the block has just been loaded, it is
+	 * an always hit and it does not change the state.
+	 * @param cfg	Analyzed CFG.
+	 * @param info	Information of the CFG.
+	 */
+	void prune(CFG *cfg, const CFGInfo *info) {
+		delete scopes;
+		delete [] sums;
+		scopes = new BitVector(cfg->countBB());
+		sums = new genstruct::Vector<step_t>[cfg->countBB()];
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			BasicBlock *header = info->innermost(bb);
+			const Bag<PolyAccess>& accesses = info->accesses(bb);
+			for(int i = 0; i < accesses.count(); i++)
+				if(accesses[i].cached() && accesses[i].ref() != poly.bot && concerns(accesses[i])) {
+					genstruct::Vector<step_t>& sum = sums[bb->number()];
+					step_t st;
+					st.index = i;
+					st.ref = normalize(accesses[i].ref());
+					st.id = indexOf(st.ref);
+					st.merged = false;
+					for(int j = sum.length() - 1; j >= 0; j--)
+						if(!sum[j].merged) {
+							st.merged = st.ref != poly.top && sum[j].ref == st.ref;
+							break;
+						}
+					sum.add(st);
+					if(header && accesses[i].ref() != poly.top)
+						scopes->set(header->number());
 				}
-				s1 = s1->next;
-				s2 = s2->next;
-			}
-		//cerr << (s1 == s2) << io::endl;
-		return s1 == s2;
+		}
+		pers.prune(scopes, info);
 	}
 
 	void dump(io::Output& out, t s) {
@@ -154,11 +251,22 @@ public:
 		else if(s2 == _bot)
 			r = s1;
 
+		// same states
+		else if(s1 == s2)
+			r = s1;
+
+		// already computed join
+		else if(memo[slot(s1, s2)].s1 == s1 && memo[slot(s1, s2)].s2 == s2) {
+			stat.hits++;
+			r = memo[slot(s1, s2)].r;
+		}
+
 		// prepare the join
 		else {
 			Node **q = &r;
 			Node *p1 = s1, *p2 = s2;
 			r = 0;
+			stat.misses++;
 
 			// merge the states
 			while(p1 && p2) {
@@ -201,6 +309,13 @@ public:
 				q = &(nn->next);
 				p = p->next;
 			}
+
+			// record the result
+			r = intern(r);
+			memo_t& m = memo[slot(s1, s2)];
+			m.s1 = s1;
+			m.s2 = s2;
+			m.r = r;
 		}
 
 		// return result
@@ -209,25 +324,107 @@ public:
 		return r;
 	}
 
+	/**
+	 * Get the counters of the join memoization.
+	 * @return	Join counters.
+	 */
+	inline const join_stat_t& joinStat(void) const { return stat; }
+
+	/**
+	 * Get the statistics of the lengths of the states output by the blocks.
+	 * @return	ACS length statistics.
+	 */
+	inline const acs_stat_t& acsStat(void) const { return lstat; }
+
+	/**
+	 * Enable or disable the sweep mode: the results are then computed
+	 * for every associativity from 1 to the one of the geometry.
+	 * @param enabled	True to enable the sweep mode.
+	 */
+	inline void sweepWays(bool enabled) { sweep = enabled; }
+
+	/**
+	 * Get the number of result vectors filled by @ref collect().
+	 * @return	Count of result vectors.
+	 */
+	inline int resultCount(void) const { return sweep ? geom.ways() : 1; }
+
 	t update(BasicBlock *bb, const PolyAccess& a, t s) {
 
 		// are we concerned by this access?
 		//QDCACHE_DEBUG(cerr << "\ttesting "; a.print(cerr, poly); cerr << io::endl);
-		if(!a.cached() || a.ref() == poly.bot || !rman.concerns(a.ref(), set))
+		if(!a.cached() || a.ref() == poly.bot || !concerns(a))
 			return s;
+		return apply(bb, a, s);
+	}
+
+	/**
+	 * Update the state with all the accesses of a basic block.
+	 * The accesses of the block summary are applied in turn on
+	 * the intermediate lists, and the result is only made unique once.
+	 * @param bb		Basic block.
+	 * @param accesses	Accesses of the basic block.
+	 * @param s			Input state.
+	 * @return			Output state.
+	 */
+	t update(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s) {
+		const genstruct::Vector<step_t>& sum = sums[bb->number()];
+		if(sum.isEmpty())
+			return s;
+		for(int i = 0; i < sum.length(); i++)
+			if(!sum[i].merged) {
+				s = step(bb, sum[i].ref, sum[i].id, s);
+					QDCACHE_DO_CHECK(s);
+			}
+		s = intern(s);
+		int len = 0;
+		for(Node *n = s; n; n = n->next)
+			len++;
+		lstat.add(len);
+		return s;
+	}
+
+	/**
+	 * Test if the current set is concerned by the given access.
+	 * @param a		Tested access.
+	 * @return		True if it is concerned, false else.
+	 */
+	inline bool concerns(const PolyAccess& a) { return rman.concerns(a.ref(), set); }
+
+	/**
+	 * Update the state with an access known to concern the current set.
+	 * @param bb	Basic block containing the access.
+	 * @param a		Performed access.
+	 * @param s		State before the access.
+	 * @return		State after the access.
+	 */
+	inline t apply(BasicBlock *bb, const PolyAccess& a, t s) {
 		QDCACHE_DEBUG(cerr << "\t"; a.print(cerr, poly); cerr << io::endl);
+		ref_t ref = normalize(a.ref());
+		return intern(step(bb, ref, indexOf(ref), s));
+	}
+
+	/**
+	 * Update the state with an access known to concern the current set
+	 * without making the result unique (the new nodes remain fresh).
+	 * @param bb	Basic block containing the access.
+	 * @param ref	Normalized reference of the access.
+	 * @param id	Index of ref in the conflict graph (or -1).
+	 * @param s		State before the access.
+	 * @return		State after the access.
+	 */
+	t step(BasicBlock *bb, ref_t ref, int id, t s) {
 
 		// convert bot to top (for standard processing)
 		if(s == _bot)
 			s = _top;
 
 		// find the age of the reference if any
-		ref_t ref = normalize(a.ref());
 		age_t age = -1;
-		if(a.ref() == poly.top)
-			age = A;
+		if(ref == poly.top)
+			age = geom.ways();
 		else {
-			for(Node *n = s; n && age < A; n = n->next) {
+			for(Node *n = s; n && age < geom.ways(); n = n->next) {
 
 				// find worst age
 				age_t wage = n->must;
@@ -235,20 +432,34 @@ public:
 					wage = max(wage, n->pers[i]);
 
 				// if needed, test for meet of references
-				if(wage < A									// out of the cache
+				if(wage < geom.ways()							// out of the cache
 				&& (	(poly.equals(n->ref, ref) && n->gen == 0)		// equal but older generation
 					||	(   !poly.equals(n->ref, ref)
-						 && rman.mayMeet(n->ref, n->gen, ref, 0))))		// not equal but meet
+						 && mayMeet(n->ref, n->id, n->gen, ref, id, 0))))	// not equal but meet
 					age = max(age, wage);
 			}
 			if(age == -1)
-				age = A;
+				age = geom.ways();
 		}
 
-		// rebuild the list
+		// look for the last node to modify
+		Node *last = 0;
+		for(Node *n = s; n; n = n->next)
+			if(compare(ref, 0, n->ref, n->gen) == 0
+			|| must.changes(n->must, age)
+			|| pers.changes(n->pers, age))
+				last = n;
+
+		// rebuild the list up to the last modified node, share the tail
 		Node *r = 0, **q = &r;
 		bool found = ref == poly.top;
 		while(s) {
+			if(found && !last) {
+				*q = s;
+				break;
+			}
+			if(s == last)
+				last = 0;
 			Node *n;
 			int c = compare(ref, 0, s->ref, s->gen);
 
@@ -292,12 +503,13 @@ public:
 
 	/**
 	 * Called to transform a state when entering a loop.
-	 * Basically, add a new persistence level.
-	 * @param s		State to traform.
-	 * @return		Transformed state.
+	 * Basically, add a new persistence level (if the loop is tracked).
+	 * @param s			State to traform.
+	 * @param header	Header of the entered loop.
+	 * @return			Transformed state.
 	 */
-	t enter(t s) {
-		if(s == _bot)
+	t enter(t s, BasicBlock *header) {
+		if(s == _bot || !pers.tracks(header))
 			return s;
 		Node *r = 0, **q = &r;
 		while(s) {
@@ -308,13 +520,15 @@ public:
 			q = &n->next;
 			s = s->next;
 		}
-		return r;
+		return intern(r);
 	}
 
 	/**
 	 * Called to transform a state when leaving a loop.
 	 * Remove a persistence level and references depending on the current
-	 * (replaced if possible by constant values).
+	 * (replaced if possible by constant values). The constant value is rounded
+	 * to its block, merged with a node of the same block if any, and dropped
+	 * if the block is not in the current set.
 	 * @param s			State to traform.
 	 * @param header	Header of the left loop.
 	 * @return			Transformed state.
@@ -322,20 +536,30 @@ public:
 	t leave(t s, BasicBlock *header) {
 		if(s == _bot)
 			return s;
+		bool tracked = pers.tracks(header);
 		Node *r = 0, **q = &r;
 		while(s) {
 
 			// current loop reference
-			if(s->ref->h == header) {
+			if(s->ref->h == poly.header(header)) {
 				// known last value
 				address_t base, top;
 				ot::size off;
-				if(poly.toAddress(s->ref, base, top, off) && poly.isTopPrecise(s->ref)) {
-					Node *n = make(poly.make(top - (s->gen + 1) * off), 0);
+				if(poly.toAddress(s->ref, base, top, off) && poly.isTopPrecise(s->ref)
+				&& geom.set(top - (s->gen + 1) * off) == set) {
+					Node *n = make(poly.make(geom.round(top - (s->gen + 1) * off)), 0);
 					n->must = s->must;
-					pers.leave(n->pers, s->pers);
-					*q = n;
-					q = &n->next;
+					if(tracked)
+						pers.leave(n->pers, s->pers);
+					else
+						n->pers = s->pers;
+					Node *m = find(r, n->ref);
+					if(m)
+						merge(m, n);
+					else {
+						*q = n;
+						q = &n->next;
+					}
 				}
 			}
 
@@ -344,15 +568,21 @@ public:
 				//Node *n = new(alloc) Node(s);
 				Node *n = make(s);
 				n->must = s->must;
-				pers.leave(n->pers, s->pers);
-				*q = n;
-				q = &n->next;
+				if(tracked)
+					pers.leave(n->pers, s->pers);
+				Node *m = n->ref->h ? 0 : find(r, n->ref);
+				if(m)
+					merge(m, n);
+				else {
+					*q = n;
+					q = &n->next;
+				}
 			}
 
 			// next node
 			s = s->next;
 		}
-		return r;
+		return intern(r);
 	}
 
 	/**
@@ -364,7 +594,7 @@ public:
 	t back(t s) {
 		Node *r = 0, **q = &r;
 		while(s) {
-			if(s->gen < A) {
+			if(s->gen < geom.ways()) {
 
 				// build the node
 				Node *n = make(s);
@@ -383,7 +613,7 @@ public:
 			}
 			s = s->next;
 		}
-		return r;
+		return intern(r);
 	}
 
 	/**
@@ -392,7 +622,7 @@ public:
 	 * @param c2	Second category.
 	 * @return		Joined category.
 	 */
-	cache::category_t joinCat(cache::category_t c1, cache::category_t c2) {
+	static cache::category_t joinCat(cache::category_t c1, cache::category_t c2) {
 		if(c1 == c2)
 			return c1;
 		else if(c1 == cache::INVALID_CATEGORY)
@@ -410,7 +640,7 @@ public:
 	 * @param acc	Access to assign category to.
 	 * @param cat	Category to join.
 	 */
-	void assignCat(PolyAccess& acc, cache::category_t cat) {
+	static void assignCat(PolyAccess& acc, cache::category_t cat) {
 		//cerr << "DEBUG: assign at " << acc.inst()->address() << " (" << *cache::CATEGORY(acc) << ") with " << cat << " => ";
 		cache::CATEGORY(acc) = joinCat(cache::CATEGORY(acc), cat);
 		//cerr << *cache::CATEGORY(acc) << io::endl;
@@ -418,13 +648,17 @@ public:
 
 	/**
 	 * Count the number of misses for the current line.
+	 * As LRU has the inclusion property, the ages computed for the
+	 * associativity of the analysis are also valid bounds for a lower
+	 * associativity: the blocks are then alive if their age is less
+	 * than this associativity.
 	 * @param access	Concerned access.
 	 * @param s			State before access.
+	 * @param res		Result to record statistics and category in.
+	 * @param ways		Associativity to classify for (at most the one of the geometry).
 	 * @return			Count of misses.
-	 * @param count		Used to return the count.
-	 * @param bb		Count relative to the given header or null (absolute value).
 	 */
-	miss_count_t countMisses(PolyAccess& access, t s) {
+	miss_count_t countMisses(const PolyAccess& access, t s, result_t& res, age_t ways) {
 #ifdef DEBUG_COUNT_MISSES
 		cerr << "set = " << set << "\t";
 		access.print(cerr, poly);
@@ -433,8 +667,8 @@ public:
 
 		// T access
 		if(access.ref() == poly.top) {
-			(*STAT(access)).nc++;
-			assignCat(access, cache::NOT_CLASSIFIED);
+			res.stat.nc++;
+			res.cat = joinCat(res.cat, cache::NOT_CLASSIFIED);
 #ifdef DEBUG_STATS			
 			cerr << "DEBUG: reference to T\n";
 #endif			
@@ -445,6 +679,7 @@ public:
 		}
 
 		ref_t ref = normalize(access.ref());
+		int id = indexOf(ref);
 		genstruct::Vector<Node *> to_scan;
 
 		// scan the ACS for interesting information
@@ -453,12 +688,12 @@ public:
 			if(poly.equals(n->ref, ref)) {
 
 				// always hist case
-				if(must.isAlive(n->must)) {
+				if(alive(n->must, ways)) {
 #ifdef DEBUG_COUNT_MISSES
 					cerr << "in MUST\n";
 #endif
-					(*STAT(access)).ah++;
-					assignCat(access, cache::ALWAYS_HIT);
+					res.stat.ah++;
+					res.cat = joinCat(res.cat, cache::ALWAYS_HIT);
 #ifdef DEBUG_STATS
 					cerr << "DEBUG: AH at " << access.inst()->address() << " to "; poly.dump(cerr, access.ref()); cerr << io::endl;
 #endif					
@@ -466,10 +701,10 @@ public:
 				}
 
 				// persistent case
-				if(pers.isAlive(n->pers)) {
+				if(alive(n->pers[0], ways)) {
 					persistent = true;
-					(*STAT(access)).pe++;
-					assignCat(access, cache::FIRST_MISS);
+					res.stat.pe++;
+					res.cat = joinCat(res.cat, cache::FIRST_MISS);
 #ifdef DEBUG_STATS					
 					cerr << "DEBUG: PE at " << access.inst()->address() << " to "; poly.dump(cerr, access.ref()); cerr << io::endl;
 #endif					
@@ -478,31 +713,36 @@ public:
 			}
 
 			// meet at some points
-			else if((must.isAlive(n->must) || pers.isAlive(n->pers))
-			&& rman.mayMeet(ref, 0, n->ref, n->gen)
-			&& rman.isCompatible(ref, n->ref))
+			else if((alive(n->must, ways) || alive(n->pers[0], ways))
+			&& mayMeet(ref, id, 0, n->ref, n->id, n->gen)
+			&& isCompatible(ref, id, n->ref, n->id))
 				to_scan.add(n);
 		}
 
 		// build the initial list of misses
 		// TODO		Take into account generations!
-		int mcount = 0;
+		miss_count_t mcount = 0;
 		elm::t::uint32 last_tag = -1;
-		RefManager::RefIter iter(ref);
+		RefManager::RefIter iter(poly, ref);
 		if(iter.failed()) { // if we could not bound the maxiter of the loop
-			(*STAT(access)).nc++;
-			assignCat(access, cache::NOT_CLASSIFIED);
+			res.stat.nc++;
+			res.cat = joinCat(res.cat, cache::NOT_CLASSIFIED);
 			return UNBOUNDED;
 		}
 		bool is_mm = false;
-		for(; iter; iter++)
-			if(cache->set(*iter) == set && (!persistent || cache->tag(*iter) != last_tag)) {
-				last_tag = cache->tag(*iter);
+
+		// no other reference may have loaded the blocks: closed form
+		bool done = to_scan.isEmpty() && countPeriodic(ref, persistent, mcount);
+
+		// else enumerate the addresses
+		for(; !done && iter; iter++)
+			if(geom.set(*iter) == set && (!persistent || geom.tag(*iter) != last_tag)) {
+				last_tag = geom.tag(*iter);
 
 				// examine if some other ref is already loaded the block
 				bool found = false;
 				for(int i = 0; i < to_scan.length(); i++)
-					if(cache->tag(iter.apply(to_scan[i]->ref)) == last_tag) {
+					if(geom.tag(iter.apply(to_scan[i]->ref)) == last_tag) {
 						found = true;
 						break;
 					}
@@ -516,18 +756,18 @@ public:
 			}
 		if(!persistent) {
 			if(is_mm) {
-				(*STAT(access)).mm++;
+				res.stat.mm++;
 #ifdef DEBUG_STATS				
 				cerr << "DEBUG: MM at " << access.inst()->address() << " to "; poly.dump(cerr, access.ref()); cerr << io::endl;
 #endif
-				assignCat(access, cache::NOT_CLASSIFIED);
+				res.cat = joinCat(res.cat, cache::NOT_CLASSIFIED);
 			}
 			else {
-				(*STAT(access)).am++;
+				res.stat.am++;
 #ifdef DEBUG_STATS				
 				cerr << "DEBUG: AM at " << access.inst()->address() << " to "; poly.dump(cerr, access.ref()); cerr << io::endl;
 #endif
-				assignCat(access, cache::NOT_CLASSIFIED);
+				res.cat = joinCat(res.cat, cache::NOT_CLASSIFIED);
 			}
 		}
 
@@ -535,20 +775,183 @@ public:
 		return mcount;
 	}
 
+	/**
+	 * Compute the results of the accesses of a basic block.
+	 * @param bb		Basic block.
+	 * @param accesses	Accesses of the basic block.
+	 * @param s			State at the input of the basic block.
+	 * @param results	Vector to add results to (in sweep mode, one vector
+	 * 					per associativity from 1 to the one of the geometry).
+	 */
+	void collect(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s, genstruct::Vector<result_t> *results) {
+		const genstruct::Vector<step_t>& sum = sums[bb->number()];
+		int cnt = resultCount();
+		for(int i = 0, j = 0; i < accesses.count(); i++) {
+
+			// coalesced access: hit on the block just loaded
+			if(j < sum.length() && sum[j].index == i && sum[j].merged) {
+				result_t r;
+				r.stat.ah++;
+				r.cat = cache::ALWAYS_HIT;
+				for(int k = 0; k < cnt; k++)
+					results[k].add(r);
+				j++;
+				continue;
+			}
+
+			for(int k = 0; k < cnt; k++) {
+				result_t r;
+				r.miss = countMisses(accesses[i], s, r, sweep ? k + 1 : geom.ways());
+				results[k].add(r);
+			}
+			if(j < sum.length() && sum[j].index == i) {
+				s = step(bb, sum[j].ref, sum[j].id, s);
+				j++;
+			}
+		}
+	}
+
 private:
 	typedef Poly::address_t address_t;
 	typedef Poly::coef_t coef_t;
 
 	/**
-	 * Normalize a reference to store in the ACS.
+	 * Count in closed form the misses of a reference in the current set
+	 * when no other reference may have loaded its blocks. As the set of an
+	 * address only depends on the address modulo P = block size * set count,
+	 * a term c*i is periodic of period P / gcd(c, P): the residues modulo P
+	 * are computed with their multiplicity over one period and scaled
+	 * by the loop bound.
+	 *
+	 * For a persistent access, the misses are the changes of blocks: this is
+	 * only supported for a single loop term.
+	 *
+	 * @param ref			Reference (with bounded loops).
+	 * @param persistent	True if the access is persistent.
+	 * @param count			Set to the count of misses.
+	 * @return				True if the count has been computed, false if
+	 * 						the addresses have to be enumerated.
+	 */
+	bool countPeriodic(ref_t ref, bool persistent, miss_count_t& count) {
+		typedef elm::t::int64 val_t;
+		ref_t p = ref;
+		while(p->h)
+			p++;
+
+		// persistent single term: count the blocks in the set
+		if(persistent) {
+			if(ref->h && ref[1].h)
+				return false;
+			if(!ref->h) {
+				count = geom.set(address_t(p->c)) == set ? 1 : 0;
+				return true;
+			}
+			val_t m = max(poly.maxIteration(ref->h), 1);
+			val_t a1 = address_t(p->c), a2 = a1 + val_t(ref->c) * (m - 1);
+			if(elm::abs(ref->c) >= geom.blockSize())
+				persistent = false;
+			else {
+				val_t k1 = min(a1, a2) >> geom.blockBits(), k2 = max(a1, a2) >> geom.blockBits();
+				count = floorDiv(k2 - set, geom.setCount()) - floorDiv(k1 - 1 - set, geom.setCount());
+				return true;
+			}
+		}
+
+		// count the residues modulo P with their multiplicity
+		address_t P = geom.blockSize() * geom.setCount();
+		if(!acc) {
+			acc = new miss_count_t[P];
+			for(address_t i = 0; i < P; i++)
+				acc[i] = 0;
+		}
+		residues.clear();
+		residues.add(pair(address_t(p->c) & (P - 1), miss_count_t(1)));
+		for(p = ref; p->h; p++) {
+			address_t m = max(poly.maxIteration(p->h), 1), c = address_t(p->c) & (P - 1);
+			address_t per = min(m, c ? P / gcd(c, P) : 1), full = m / per, rem = m % per;
+			genstruct::Vector<address_t> touched;
+			for(int j = 0; j < residues.length(); j++)
+				for(address_t i = 0, a = residues[j].fst; i < per; i++, a = (a + c) & (P - 1)) {
+					if(!acc[a])
+						touched.add(a);
+					acc[a] += residues[j].snd * (full + (i < rem ? 1 : 0));
+				}
+			residues.clear();
+			for(int j = 0; j < touched.length(); j++) {
+				residues.add(pair(touched[j], acc[touched[j]]));
+				acc[touched[j]] = 0;
+			}
+		}
+
+		// sum the accesses in the set
+		count = 0;
+		for(int j = 0; j < residues.length(); j++)
+			if(residues[j].fst >> geom.blockBits() == set)
+				count += residues[j].snd;
+		return true;
+	}
+
+	static elm::t::int64 floorDiv(elm::t::int64 a, elm::t::int64 b)
+		{ return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+	static address_t gcd(address_t a, address_t b)
+		{ while(b) { address_t r = a % b; a = b; b = r; } return a; }
+
+	/**
+	 * Get the index of a reference in the conflict graph.
+	 * @param r		Looked reference.
+	 * @return		Index or -1 if there is no graph or r is not in the graph.
+	 */
+	inline int indexOf(ref_t r) const { return conflicts ? conflicts->indexOf(r) : -1; }
+
+	/**
+	 * Test if two references may meet, using the conflict graph if both are in it.
+	 * @param r1	First reference.
+	 * @param i1	Index of the first reference in the conflict graph (or -1).
+	 * @param g1	Generation of the first reference.
+	 * @param r2	Second reference.
+	 * @param i2	Index of the second reference in the conflict graph (or -1).
+	 * @param g2	Generation of the second reference.
+	 * @return		True if they may meet, false else.
+	 */
+	inline bool mayMeet(ref_t r1, int i1, int g1, ref_t r2, int i2, int g2) {
+		if(i1 >= 0 && i2 >= 0 && i1 != i2)
+			return conflicts->mayMeet(i1, i2);
+		else
+			return rman.mayMeet(r1, g1, r2, g2);
+	}
+
+	/**
+	 * Test if r2 is compatible with r1, using the conflict graph if both are in it.
+	 * @param r1	Reference reference.
+	 * @param i1	Index of r1 in the conflict graph (or -1).
+	 * @param r2	Tested reference.
+	 * @param i2	Index of r2 in the conflict graph (or -1).
+	 * @return		True if compatible, false else.
+	 */
+	inline bool isCompatible(ref_t r1, int i1, ref_t r2, int i2) {
+		if(i1 >= 0 && i2 >= 0)
+			return conflicts->isCompatible(i1, i2);
+		else
+			return rman.isCompatible(r1, r2);
+	}
+
+	/**
+	 * Normalize a reference to store in the ACS: constant references are
+	 * rounded to their block and the other ones are replaced by
+	 * the representative of their group in the conflict graph.
 	 * @param r		Reference to normalize.
 	 * @return		Normalized reference.
 	 */
 	ref_t normalize(ref_t r) {
-		if(r->h || r == poly.top || r == poly.bot)
+		if(r == poly.top || r == poly.bot)
 			return r;
-		else
-			return poly.make(cache->round(r->c));
+		else if(!r->h)
+			return poly.make(geom.round(r->c));
+		else {
+			int i = indexOf(r);
+			return i >= 0 ? conflicts->group(i) : r;
+		}
 	}
 
 	/**
@@ -559,7 +962,7 @@ private:
 
 		// simple case of constant addresses
 		if(!r1->h && !r2->h)
-			return cache->tag(r1->c) == cache->tag(r2->c);
+			return geom.tag(r1->c) == geom.tag(r2->c);
 
 		// else just consider strict equality
 		// TODO		May be improved by block equivalent checking (really useful?)
@@ -604,31 +1007,773 @@ private:
 		return r;
 	}
 
-	int A;
-	const hard::Cache *cache;
+	/**
+	 * Find the node of a constant reference in a list.
+	 * @param l		List to look in.
+	 * @param ref	Looked reference.
+	 * @return		Found node or null.
+	 */
+	static Node *find(Node *l, ref_t ref) {
+		for(; l; l = l->next)
+			if(l->ref == ref && l->gen == 0)
+				return l;
+		return 0;
+	}
+
+	/**
+	 * Merge the ages of a node into a node accessing the same block:
+	 * the youngest ages are kept.
+	 * @param n		Node to merge into.
+	 * @param m		Merged node.
+	 */
+	static void merge(Node *n, Node *m) {
+		n->must = younger(n->must, m->must);
+		for(int i = 0; i < n->pers.length(); i++)
+			n->pers[i] = younger(n->pers[i], m->pers[i]);
+	}
+
+	static inline bool alive(age_t a, age_t ways) { return a >= 0 && a < ways; }
+
+	static inline age_t younger(age_t a1, age_t a2)
+		{ if(a1 == NO_AGE) return a2; else if(a2 == NO_AGE) return a1; else return min(a1, a2); }
+
+	/**
+	 * Get the slot of the join memoization table for a pair of states.
+	 * As the states are unique, the pointers identify them.
+	 * @param s1	First state.
+	 * @param s2	Second state.
+	 * @return		Slot index.
+	 */
+	static inline int slot(t s1, t s2) {
+		elm::t::uint32 h = elm::t::uint32(elm::t::intptr(s1)) * 2654435761u ^ elm::t::uint32(elm::t::intptr(s2));
+		return (h ^ (h >> 16)) & (memo_size - 1);
+	}
+
+	/**
+	 * Get the unique instance of a state. The fresh nodes are processed from
+	 * the tail of the list to the head: each node is replaced by its unique
+	 * instance (if any) or becomes the unique instance. The processing stops
+	 * at the first already unique node, as a shared tail.
+	 * @param s		Freshly built state.
+	 * @return		Unique instance of the state.
+	 */
+	t intern(t s) {
+		stack.clear();
+		for(; s && !s->unique; s = s->next)
+			stack.push(s);
+		Node *r = s;
+		while(stack) {
+			Node *n = stack.pop();
+			n->next = r;
+			n->hash = hash(n);
+			r = 0;
+			for(Node *c = htab[n->hash & (hsize - 1)]; c && !r; c = c->hnext)
+				if(c->hash == n->hash && same(c, n))
+					r = c;
+			if(!r) {
+				add(n);
+				r = n;
+			}
+		}
+		return r;
+	}
+
+	/**
+	 * Compute the hash code of a node (its tail being already unique).
+	 * @param n		Node to hash.
+	 * @return		Hash code.
+	 */
+	static elm::t::uint32 hash(Node *n) {
+		elm::t::uint32 h = 2166136261u;
+		h = (h ^ elm::t::uint32(elm::t::intptr(n->ref))) * 16777619u;
+		h = (h ^ elm::t::uint32(elm::t::intptr(n->next))) * 16777619u;
+		h = (h ^ elm::t::uint32(n->gen)) * 16777619u;
+		h = (h ^ elm::t::uint8(n->must)) * 16777619u;
+		for(int i = 0; i < n->pers.length(); i++)
+			h = (h ^ elm::t::uint8(n->pers[i])) * 16777619u;
+		return h;
+	}
+
+	/**
+	 * Test if two nodes (whose tails are unique) are structurally equal.
+	 * @param n1	First node.
+	 * @param n2	Second node.
+	 * @return		True if they are equal, false else.
+	 */
+	static bool same(Node *n1, Node *n2) {
+		if(n1->ref != n2->ref || n1->next != n2->next || n1->gen != n2->gen
+		|| n1->must != n2->must || n1->pers.length() != n2->pers.length())
+			return false;
+		for(int i = 0; i < n1->pers.length(); i++)
+			if(n1->pers[i] != n2->pers[i])
+				return false;
+		return true;
+	}
+
+	/**
+	 * Record a new unique node, growing the table if needed.
+	 * @param n		Node to add.
+	 */
+	void add(Node *n) {
+		if(hcount >= hsize * 2) {
+			int nsize = hsize * 2;
+			Node **ntab = new Node *[nsize];
+			for(int i = 0; i < nsize; i++)
+				ntab[i] = 0;
+			for(int i = 0; i < hsize; i++)
+				for(Node *c = htab[i], *next; c; c = next) {
+					next = c->hnext;
+					c->hnext = ntab[c->hash & (nsize - 1)];
+					ntab[c->hash & (nsize - 1)] = c;
+				}
+			delete [] htab;
+			htab = ntab;
+			hsize = nsize;
+		}
+		n->hnext = htab[n->hash & (hsize - 1)];
+		htab[n->hash & (hsize - 1)] = n;
+		n->unique = true;
+		hcount++;
+	}
+
+	G geom;
 	unsigned int set;
 	StackAllocator alloc;
 	t _bot, _top;
 	Node bot_node;
 	Poly& poly;
 	RefManager& rman;
-	Must must;
-	Persistence pers;
+	const ConflictGraph *conflicts;
+	Must<G> must;
+	Persistence<G> pers;
+	miss_count_t *acc;
+	genstruct::Vector<Pair<address_t, miss_count_t> > residues;
+	Node **htab;
+	int hsize, hcount;
+	genstruct::Vector<Node *> stack;
+	BitVector *scopes;
+
+	// block summaries: accesses of each block updating the set
+	typedef struct step_t {
+		int index;
+		ref_t ref;
+		int id;
+		bool merged;	// coalesced with the previous access
+	} step_t;
+	genstruct::Vector<step_t> *sums;
+	bool sweep;
+
+	// join memoization (direct-mapped)
+	static const int memo_size = 1024;
+	typedef struct memo_t {
+		t s1, s2, r;
+	} memo_t;
+	memo_t memo[memo_size];
+	join_stat_t stat;
+	acs_stat_t lstat;
+};
+
+// list engine for any cache geometry
+typedef BasicPIDManager<RuntimeGeometry> PIDManager;
+
+/**
+ * Manager performing the analysis of all cache sets in one traversal
+ * of the CFG. The state is made of one PIDManager state (lane) per set
+ * and the accesses, the edges and the work list are processed once
+ * for all sets. A per-block memory of the lanes allows to skip the
+ * lanes whose input has not changed since the last visit.
+ */
+class MultiSetManager {
+public:
+	typedef PIDManager::t *t;
+
+	MultiSetManager(CFG *cfg, int set_count, Poly& _poly, RefManager& rman, const ConflictGraph *conflicts = 0)
+		:	n(set_count),
+			poly(_poly),
+		 	mans(new PIDManager *[set_count]),
+		 	done(new bool[set_count]),
+		 	ins(new t[cfg->countBB()]),
+		 	outs(new t[cfg->countBB()])
+	{
+		for(int i = 0; i < n; i++)
+			mans[i] = new PIDManager(i, poly, rman, conflicts);
+		for(int i = 0; i < cfg->countBB(); i++)
+			ins[i] = outs[i] = 0;
+		_bot = make();
+		_top = make();
+		for(int i = 0; i < n; i++) {
+			_bot[i] = mans[i]->bot();
+			_top[i] = mans[i]->init();
+		}
+	}
+
+	~MultiSetManager(void) {
+		for(int i = 0; i < n; i++)
+			delete mans[i];
+		delete [] mans;
+		delete [] done;
+		delete [] ins;
+		delete [] outs;
+	}
+
+	inline int count(void) const { return n; }
+	inline t bot(void) const { return _bot; }
+	inline t init(void) const { return _top; }
+
+	bool equals(t s1, t s2) {
+		if(s1 == s2)
+			return true;
+		for(int i = 0; i < n; i++)
+			if(!mans[i]->equals(s1[i], s2[i]))
+				return false;
+		return true;
+	}
+
+	void dump(io::Output& out, t s) {
+		for(int i = 0; i < n; i++) {
+			out << "set " << i << ": ";
+			mans[i]->dump(out, s[i]);
+		}
+	}
+
+	t join(t s1, t s2) {
+		if(s1 == _bot)
+			return s2;
+		else if(s2 == _bot)
+			return s1;
+		t r = make();
+		for(int i = 0; i < n; i++)
+			r[i] = s1[i] == s2[i] ? s1[i] : mans[i]->join(s1[i], s2[i]);
+		return r;
+	}
+
+	/**
+	 * Update the state with all the accesses of a basic block.
+	 * The lanes whose input is equal to the one of the previous visit
+	 * of the block just take back their previous output.
+	 * @param bb		Basic block.
+	 * @param accesses	Accesses of the basic block.
+	 * @param s			Input state.
+	 * @return			Output state.
+	 */
+	t update(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s) {
+		if(!accesses.count())
+			return s;
+		t r = make();
+
+		// reuse converged lanes
+		int bn = bb->number();
+		t in = ins[bn], out = outs[bn];
+		for(int i = 0; i < n; i++) {
+			done[i] = in && mans[i]->equals(in[i], s[i]);
+			r[i] = done[i] ? out[i] : s[i];
+		}
+
+		// apply the block summaries to the remaining lanes
+		for(int i = 0; i < n; i++)
+			if(!done[i])
+				r[i] = mans[i]->update(bb, accesses, s[i]);
+
+		// record the lanes for the next visit
+		ins[bn] = s;
+		outs[bn] = r;
+		return r;
+	}
+
+	t enter(t s, BasicBlock *header) {
+		t r = make();
+		for(int i = 0; i < n; i++)
+			r[i] = mans[i]->enter(s[i], header);
+		return r;
+	}
+
+	t leave(t s, BasicBlock *header) {
+		t r = make();
+		for(int i = 0; i < n; i++)
+			r[i] = mans[i]->leave(s[i], header);
+		return r;
+	}
+
+	t back(t s) {
+		t r = make();
+		for(int i = 0; i < n; i++)
+			r[i] = mans[i]->back(s[i]);
+		return r;
+	}
+
+	/**
+	 * Compute the results of the accesses of a basic block for all sets.
+	 * @param bb		Basic block.
+	 * @param accesses	Accesses of the basic block.
+	 * @param s			State at the input of the basic block.
+	 * @param results	Vectors (one per set) to add results to.
+	 */
+	void collect(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s, genstruct::Vector<result_t> *results) {
+		for(int i = 0; i < n; i++)
+			mans[i]->collect(bb, accesses, s[i], results + i * mans[i]->resultCount());
+	}
+
+	void sweepWays(bool enabled) {
+		for(int i = 0; i < n; i++)
+			mans[i]->sweepWays(enabled);
+	}
+
+	void prune(CFG *cfg, const CFGInfo *info) {
+		for(int i = 0; i < n; i++)
+			mans[i]->prune(cfg, info);
+	}
+
+	join_stat_t joinStat(void) const {
+		join_stat_t s;
+		for(int i = 0; i < n; i++)
+			s += mans[i]->joinStat();
+		return s;
+	}
+
+	inline const acs_stat_t& acsStat(int set) const { return mans[set]->acsStat(); }
+
+private:
+	inline t make(void) { return static_cast<t>(alloc.allocate(sizeof(PIDManager::t) * n)); }
+
+	int n;
+	Poly& poly;
+	PIDManager **mans;
+	bool *done;
+	t *ins, *outs;
+	StackAllocator alloc;
+	t _bot, _top;
+};
+
+/**
+ * Dense engine for the abstract cache states of one cache set.
+ * The normalized references of the set (and the constant references
+ * they produce when a loop is left) make a finite universe, numbered
+ * in the order of the lists of PIDManager. A state is then a flat array
+ * of bytes: one presence byte, one must age and one age per persistence
+ * level for each slot of references. Absent slots hold the neutral ages
+ * (must = A, persistence = NO_AGE) so that the join of the ages is a byte-wise maximum
+ * and the update a byte-wise conditional increment, both easily vectorized
+ * by the compiler.
+ *
+ * The misses are counted by converting the state back to a PIDManager list.
+ * The blocks are updated from the block summaries of the list engine
+ * (coalesced accesses are skipped as in the lists). As in the lists,
+ * distinct references comparing equal in the list order (same coefficients
+ * on different loops) share one slot of the state: the presence byte
+ * records which of them owns the slot (the first one accessed, or the one
+ * of the first state in a join) and the other ones only touch it. The
+ * constant block produced at loop exit is merged with the slot of the same
+ * block, keeping the younger ages (the older ones if the slot is owned by
+ * another reference comparing equal).
+ * Generations of references (WITH_GEN) are not supported.
+ */
+class DenseManager {
+	typedef PIDManager::ref_t ref_t;
+
+	// the ages follow the header in the same allocation (see data())
+	typedef struct state_t {
+		int depth;
+	} state_t;
+
+public:
+	typedef state_t *t;
+
+	DenseManager(CFG *cfg, const CFGInfo *info, int set, Poly& _poly, RefManager& _rman, int limit,
+		const ConflictGraph *conflicts = 0)
+		:	poly(_poly),
+			rman(_rman),
+			list(set, _poly, _rman, conflicts),
+			A(_rman.cache().wayCount()),
+			n(0),
+			m(0),
+			slot(0),
+			first(0),
+			meet(0),
+			derived(0),
+			_bot(0),
+			_top(0)
+	{
+		// collect the references of the set
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			const Bag<PolyAccess>& accesses = info->accesses(bb);
+			for(int i = 0; i < accesses.count(); i++)
+				if(accesses[i].cached() && accesses[i].ref() != poly.bot && accesses[i].ref() != poly.top
+				&& list.concerns(accesses[i]))
+					add(list.normalize(accesses[i].ref()));
+		}
+		for(int i = 0, c = refs.length(); i < c && refs.length() <= limit; i++) {
+			ref_t d = exitRef(refs[i]);
+			if(d)
+				add(d);
+		}
+		m = refs.length();
+		if(m > limit)
+			return;
+
+		// sort them in list order
+		for(int i = 1; i < m; i++)
+			for(int j = i; j > 0 && list.compare(refs[j], 0, refs[j - 1], 0) < 0; j--) {
+				ref_t r = refs[j];
+				refs[j] = refs[j - 1];
+				refs[j - 1] = r;
+			}
+		for(int i = 0; i < m; i++)
+			index.put(refs[i], i);
+
+		// gather the references comparing equal in one slot
+		slot = new int[m];
+		first = new int[m];
+		for(int i = 0; i < m; i++) {
+			if(!i || list.compare(refs[i], 0, refs[i - 1], 0) != 0)
+				first[n++] = i;
+			slot[i] = n - 1;
+			ASSERT(i - first[n - 1] < 127);	// owner offset stored in a presence byte
+		}
+
+		// pre-compute the meetings and the references derived at loop exit
+		meet = new bool[m * m];
+		for(int i = 0; i < m; i++)
+			for(int j = 0; j < m; j++)
+				meet[i * m + j] = i == j
+					|| list.mayMeet(refs[i], list.indexOf(refs[i]), 0, refs[j], list.indexOf(refs[j]), 0);
+		derived = new int[m];
+		for(int i = 0; i < m; i++) {
+			ref_t d = exitRef(refs[i]);
+			derived[i] = d ? index.get(d, -1) : -1;
+		}
+
+		// build bot and top
+		_bot = make(-1);
+		_top = make(-1);
+	}
+
+	~DenseManager(void) {
+		delete [] slot;
+		delete [] first;
+		delete [] meet;
+		delete [] derived;
+	}
+
+	/**
+	 * Get the reference a loop reference is replaced by when its loop is left,
+	 * as built by the list engine: its last value rounded to its block.
+	 * @param r		Reference of the left loop.
+	 * @return		Last block or null if it is unknown or not in the set.
+	 */
+	ref_t exitRef(ref_t r) {
+		Poly::address_t base, top;
+		ot::size off;
+		if(!r->h || !poly.toAddress(r, base, top, off) || !poly.isTopPrecise(r)
+		|| list.geom.set(top - off) != list.set)
+			return 0;
+		return list.normalize(poly.make(top - off));
+	}
+
+	/**
+	 * Test if the universe of references is small enough
+	 * to use the dense engine.
+	 * @return	True if the dense engine can be used.
+	 */
+	inline bool fits(void) const { return meet != 0; }
+
+	inline t bot(void) const { return _bot; }
+	inline t init(void) const { return _top; }
+	inline void prune(CFG *cfg, const CFGInfo *info) { list.prune(cfg, info); }
+	inline void sweepWays(bool enabled) { list.sweepWays(enabled); }
+
+	bool equals(t s1, t s2) const {
+		if(s1 == s2)
+			return true;
+		if(s1 == _bot || s2 == _bot || s1->depth != s2->depth)
+			return false;
+		return !memcmp(data(s1), data(s2), size(s1->depth));
+	}
+
+	void dump(io::Output& out, t s) {
+		if(s == _bot)
+			out << "{ }_bot\n";
+		else
+			list.dump(out, toList(s));
+	}
+
+	t join(t s1, t s2) {
+		if(s1 == _bot)
+			return s2;
+		if(s2 == _bot || s1 == s2)
+			return s1;
+		if(s1 == _top)
+			return undef(s2);
+		if(s2 == _top)
+			return undef(s1);
+		ASSERT(s1->depth == s2->depth);
+		t r = make(s1->depth);
+		for(int i = 0; i < n; i++)
+			present(r)[i] = present(s1)[i] ? present(s1)[i] : present(s2)[i];
+		for(int i = n, c = size(r->depth); i < c; i++)
+			data(r)[i] = max(data(s1)[i], data(s2)[i]);
+		return r;
+	}
+
+	/**
+	 * Update the state with the accesses of a basic block, using the
+	 * block summary of the list engine (coalesced accesses are skipped).
+	 * @param bb		Basic block.
+	 * @param accesses	Accesses of the basic block.
+	 * @param s			Input state.
+	 * @return			Output state.
+	 */
+	t update(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s) {
+		const genstruct::Vector<PIDManager::step_t>& sum = list.sums[bb->number()];
+		for(int i = 0; i < sum.length(); i++)
+			if(!sum[i].merged)
+				s = apply(bb, sum[i].ref, s);
+		return s;
+	}
+
+	t enter(t s, BasicBlock *header) {
+		if(s == _bot || s == _top || !list.pers.tracks(header))
+			return s;
+		t r = make(s->depth + 1);
+		memcpy(data(r), data(s), 2 * n);
+		for(int i = 0; i < n; i++)
+			pers(r, 0)[i] = NO_AGE;
+		memcpy(pers(r, 1), pers(s, 0), s->depth * n);
+		return r;
+	}
+
+	t leave(t s, BasicBlock *header) {
+		if(s == _bot || s == _top)
+			return s;
+		Poly::header_t h = poly.header(header);
+		t r = make(s->depth);
+		memcpy(data(r), data(s), size(s->depth));
+
+		// remove the persistence level
+		if(list.pers.tracks(header)) {
+			ASSERT(r->depth > 1);
+			for(int i = 0; i < n; i++)
+				pers(r, 1)[i] = max(pers(r, 0)[i], pers(r, 1)[i]);
+			r->depth--;
+			memmove(pers(r, 0), pers(r, 1), r->depth * n);
+		}
+
+		// references of the left loop: removed or merged into their last value
+		// (keeping the younger ages if it is the same block, the older ones else)
+		bool empty = true;
+		age_t ages[2 + Levels::max_depth];	// must age then persistence ages
+		for(int i = 0; i < n; i++)
+			if(present(r)[i] && refs[owner(r, i)]->h == h) {
+				int d = derived[owner(r, i)];
+				ages[0] = must(r)[i];
+				for(int l = 0; l < r->depth; l++)
+					ages[l + 1] = pers(r, l)[i];
+				present(r)[i] = 0;
+				must(r)[i] = A;
+				for(int l = 0; l < r->depth; l++)
+					pers(r, l)[i] = NO_AGE;
+				if(d >= 0) {
+					int k = slot[d];
+					if(!present(r)[k]) {
+						own(r, k, d);
+						must(r)[k] = ages[0];
+						for(int l = 0; l < r->depth; l++)
+							pers(r, l)[k] = ages[l + 1];
+					}
+					else if(owner(r, k) == d) {
+						must(r)[k] = min(must(r)[k], ages[0]);
+						for(int l = 0; l < r->depth; l++)
+							pers(r, l)[k] = PIDManager::younger(pers(r, l)[k], ages[l + 1]);
+					}
+					else {
+						must(r)[k] = max(must(r)[k], ages[0]);
+						for(int l = 0; l < r->depth; l++)
+							pers(r, l)[k] = max(pers(r, l)[k], ages[l + 1]);
+					}
+				}
+			}
+		for(int i = 0; i < n && empty; i++)
+			empty = !present(r)[i];
+		if(empty)
+			return _top;
+		return r;
+	}
+
+	inline t back(t s) { return s; }
+
+	void collect(BasicBlock *bb, const Bag<PolyAccess>& accesses, t s, genstruct::Vector<result_t> *results) {
+		list.collect(bb, accesses, toList(s), results);
+	}
+
+private:
+
+	/**
+	 * Update the state with an access concerning the set.
+	 * @param bb	Basic block containing the access.
+	 * @param ref	Normalized reference of the access.
+	 * @param s		State before the access.
+	 * @return		State after the access.
+	 */
+	t apply(BasicBlock *bb, ref_t ref, t s) {
+		if(s == _bot)
+			s = _top;
+		int j = ref == poly.top ? -1 : index.get(ref, -1);
+		ASSERT(ref == poly.top || j >= 0);
+		if(s == _top && j < 0)
+			return s;
+
+		// find the age of the reference
+		age_t age = -1;
+		if(j >= 0 && s != _top)
+			for(int i = 0; i < n; i++)
+				if(present(s)[i] && meet[owner(s, i) * m + j]) {
+					age_t wage = must(s)[i];
+					for(int l = 0; l < s->depth; l++)
+						wage = max(wage, pers(s, l)[i]);
+					if(wage < A)
+						age = max(age, wage);
+				}
+		if(age == -1)
+			age = A;
+
+		// age the references
+		t r;
+		if(s == _top) {
+			Levels levels;
+			list.pers.init(levels, bb);
+			r = make(levels.length());
+		}
+		else {
+			r = make(s->depth);
+			memcpy(present(r), present(s), n);
+			older(must(r), must(s), n, age);
+			older(pers(r, 0), pers(s, 0), s->depth * n, age);
+		}
+
+		// touch the accessed reference (the owner of its slot is kept)
+		if(j >= 0) {
+			int k = slot[j];
+			if(!present(r)[k])
+				own(r, k, j);
+			must(r)[k] = 0;
+			for(int l = 0; l < r->depth; l++)
+				pers(r, l)[k] = 0;
+		}
+		return r;
+	}
+
+	/**
+	 * Make older the ages lower or equal to the given age.
+	 * @param r		Result ages.
+	 * @param a		Source ages.
+	 * @param c		Count of ages.
+	 * @param h		Age of the access.
+	 */
+	inline void older(age_t *r, const age_t *a, int c, age_t h) const {
+		for(int i = 0; i < c; i++)
+			r[i] = a[i] != NO_AGE && a[i] != A && a[i] <= h ? a[i] + 1 : a[i];
+	}
+
+	/**
+	 * Get the state where the must ages of the present references are
+	 * undefined, that is, the join with the empty state.
+	 * @param s		State to undefine.
+	 * @return		Result state.
+	 */
+	t undef(t s) {
+		t r = make(s->depth);
+		memcpy(data(r), data(s), size(s->depth));
+		for(int i = 0; i < n; i++)
+			must(r)[i] = A;
+		return r;
+	}
+
+	/**
+	 * Convert a state to a PIDManager state.
+	 * @param s		State to convert.
+	 * @return		Matching PIDManager state.
+	 */
+	PIDManager::t toList(t s) {
+		if(s == _top)
+			return list.init();
+		PIDManager::Node *r = 0;
+		for(int i = n - 1; i >= 0; i--)
+			if(present(s)[i]) {
+				ref_t ref = refs[owner(s, i)];
+				PIDManager::Node *node = new(list.alloc) PIDManager::Node(ref, list.indexOf(ref));
+				node->must = must(s)[i];
+				node->pers.setLength(s->depth);
+				for(int l = 0; l < s->depth; l++)
+					node->pers[l] = pers(s, l)[i];
+				node->next = r;
+				r = node;
+			}
+		return list.intern(r);
+	}
+
+	void add(ref_t r) {
+		for(int i = 0; i < refs.length(); i++)
+			if(refs[i] == r)
+				return;
+		refs.add(r);
+	}
+
+	inline int size(int depth) const { return n * (2 + depth); }
+	inline age_t *data(t s) const { return reinterpret_cast<age_t *>(s + 1); }
+	inline age_t *present(t s) const { return data(s); }
+	inline int owner(t s, int i) const { return first[i] + present(s)[i] - 1; }
+	inline void own(t s, int i, int r) const { present(s)[i] = r - first[i] + 1; }
+	inline age_t *must(t s) const { return data(s) + n; }
+	inline age_t *pers(t s, int l) const { return data(s) + (2 + l) * n; }
+
+	t make(int depth) {
+		t s = static_cast<t>(alloc.allocate(sizeof(state_t) + (depth < 0 ? 0 : size(depth))));
+		s->depth = depth;
+		if(depth >= 0)
+			for(int i = 0; i < n; i++) {
+				present(s)[i] = 0;
+				must(s)[i] = A;
+				for(int l = 0; l < depth; l++)
+					pers(s, l)[i] = NO_AGE;
+			}
+		return s;
+	}
+
+	Poly& poly;
+	RefManager& rman;
+	PIDManager list;
+	age_t A;
+	int n, m;
+	int *slot, *first;
+	genstruct::Vector<ref_t> refs;
+	genstruct::HashTable<ref_t, int> index;
+	bool *meet;
+	int *derived;
+	StackAllocator alloc;
+	t _bot, _top;
 };
 
 class PIDCacheAnalysis: public CFGProcessor {
 public:
 	static p::declare reg;
-	PIDCacheAnalysis(p::declare& r = reg): CFGProcessor(r) { }
+	PIDCacheAnalysis(p::declare& r = reg): CFGProcessor(r), cache(0), jobs(1), multi(false), dense(0), sweep(false),
+		nres(1), results(0), acs(0), positions(0) { }
+
+	virtual void configure(const PropList& props) {
+		CFGProcessor::configure(props);
+		jobs = JOBS(props);
+		multi = MULTI_SET(props);
+		dense = DENSE_LIMIT(props);
+		sweep = WAY_SWEEP(props);
+	}
 
 protected:
 
-	virtual void processCFG(WorkSpace *ws, CFG *cfg) {
+	virtual void processWorkSpace(WorkSpace *ws) {
 
 		// get cache configuration
 		const hard::CacheConfiguration *conf = hard::CACHE_CONFIGURATION(ws);
 		ASSERT(conf);
-		const hard::Cache *cache = conf->dataCache();
+		cache = conf->dataCache();
 		if(!cache)
 			throw ProcessorException(*this, "no data cache available");
 		if(cache == conf->instCache())
@@ -636,9 +1781,139 @@ protected:
 		if(cache->replacementPolicy() != hard::Cache::LRU)
 			throw ProcessorException(*this, "only LRU replacement policy supported");
 
-		// process each set in turn
-		for(int i = 0; i < cache->setCount(); i++)
-			process(ws, cfg, i);
+		// index the references (before any parallel access)
+		PolyManager *pman = POLY_MANAGER(ws);
+		ASSERT(pman);
+		RefManager *rman = REF_MANAGER(ws);
+		ASSERT(rman);
+		const CFGCollection& coll = **INVOLVED_CFGS(ws);
+		for(int i = 0; i < coll.count(); i++)
+			for(CFG::BBIterator bb(coll.get(i)); bb; bb++) {
+				const Bag<PolyAccess>& accesses = *ACCESSES(bb);
+				for(int j = 0; j < accesses.count(); j++)
+					rman->index(accesses[j].ref());
+			}
+
+		// extract the properties read by the tasks (reading a PropList is not thread-safe)
+		for(int i = 0; i < coll.count(); i++)
+			infos.add(new CFGInfo(coll.get(i)));
+
+		// build the conflict graphs of the references (one per CFG)
+		for(int i = 0; i < coll.count(); i++) {
+			ConflictGraph *graph = new ConflictGraph(pman->poly(), *rman);
+			graphs.add(graph);
+			graph->add(coll.get(i));
+			graph->build(jobs);
+			if(logFor(LOG_CFG))
+				log << "\tconflict graph of " << coll.get(i)->label() << ": " << graph->count() << " reference(s), "
+					<< graph->groupCount() << " group(s)\n";
+		}
+
+		// build the tasks: one per (CFG, set) pair or one per CFG in multi-set mode
+		// (in per-set mode, only one set per class of identical signatures is analyzed)
+		// each (CFG, set) pair has one result vector per associativity in sweep mode
+		Scheduler sched(jobs);
+		nres = sweep ? cache->wayCount() : 1;
+		results = new genstruct::Vector<result_t>[coll.count() * cache->setCount() * nres];
+		acs = new acs_stat_t[coll.count() * cache->setCount()];
+		positions = new genstruct::Vector<int>[coll.count() * cache->setCount()];
+		for(int i = 0; i < coll.count(); i++) {
+			int first = i * cache->setCount();
+			firsts.put(coll.get(i), first);
+			if(multi)
+				tasks.add(new CFGTask(*this, pman->poly(), *rman, coll.get(i), infos[i], graphs[i], results + first * nres, acs + first));
+			else {
+				genstruct::Vector<int> reps;
+				genstruct::Vector<genstruct::Vector<int> *> sigs;
+				for(int j = 0; j < cache->setCount(); j++) {
+					genstruct::Vector<int> *sig = new genstruct::Vector<int>();
+					int rep = j;
+					if(!signature(coll.get(i), j, *rman, *sig, positions[first + j])) {
+						delete sig;
+						sig = 0;
+						positions[first + j].clear();
+					}
+					else
+						for(int k = 0; k < reps.length(); k++)
+							if(sigs[k] && sameSignature(*sigs[k], *sig)) {
+								rep = reps[k];
+								break;
+							}
+					if(rep == j) {
+						reps.add(j);
+						sigs.add(sig);
+						tasks.add(new SetTask(*this, pman->poly(), *rman, coll.get(i), infos[i], graphs[i], j, results + (first + j) * nres, acs + first + j));
+					}
+					else {
+						copies.add(pair(first + j, first + rep));
+						delete sig;
+					}
+				}
+				for(int k = 0; k < sigs.length(); k++)
+					delete sigs[k];
+			}
+		}
+		for(int i = 0; i < tasks.length(); i++)
+			sched.add(tasks[i]);
+		if(logFor(LOG_FUN) && !multi)
+			log << "\t" << copies.length() << " (CFG, set) pair(s) sharing the analysis of an identical set\n";
+
+		// run them and merge the results CFG by CFG
+		if(logFor(LOG_FUN))
+			log << "\tanalyzing " << tasks.length() << (multi ? " CFG(s)" : " (CFG, set) pairs")
+				<< " with " << sched.jobs() << " job(s)\n";
+		try {
+			sched.run();
+			if(logFor(LOG_FUN)) {
+				join_stat_t stat;
+				for(int i = 0; i < tasks.length(); i++)
+					stat += tasks[i]->stat;
+				log << "\tjoin memoization: " << stat.hits << " hit(s), " << stat.misses << " miss(es)\n";
+				int cnt = 0;
+				for(int i = 0; i < tasks.length(); i++)
+					if(tasks[i]->trivial)
+						cnt++;
+				log << "\t" << cnt << " set(s) classified without fixpoint\n";
+			}
+			for(int i = 0; i < copies.length(); i++) {
+				const genstruct::Vector<int>& to = positions[copies[i].fst], &from = positions[copies[i].snd];
+				for(int k = 0; k < nres; k++) {
+					const genstruct::Vector<result_t>& rres = results[copies[i].snd * nres + k];
+					genstruct::Vector<result_t>& cres = results[copies[i].fst * nres + k];
+					for(int j = 0; j < rres.length(); j++)
+						cres.add(result_t());
+					for(int j = 0; j < to.length(); j++)
+						cres[to[j]] = rres[from[j]];
+				}
+				acs[copies[i].fst] = acs[copies[i].snd];
+			}
+			CFGProcessor::processWorkSpace(ws);
+		}
+		catch(...) {
+			cleanTasks();
+			throw;
+		}
+		cleanTasks();
+	}
+
+	virtual void processCFG(WorkSpace *ws, CFG *cfg) {
+
+		// merge the results of the sets in order
+		int first = firsts.get(cfg, -1);
+		ASSERT(first >= 0);
+		for(int i = 0; i < cache->setCount(); i++) {
+			if(logFor(LOG_FILE)) {
+				log << "\tset " << i;
+				const acs_stat_t& a = acs[first + i];
+				if(a.states)
+					log << " (ACS length: average " << a.average() << ", max " << a.max << ")";
+				log << io::endl;
+			}
+			merge(cfg, results[(first + i) * nres + nres - 1]);
+			if(sweep)
+				for(int k = 0; k < nres; k++)
+					mergeWays(cfg, results[(first + i) * nres + k], k);
+		}
 
 		// put the RELATIVE_TO property
 		PolyManager *pman = POLY_MANAGER(ws);
@@ -661,9 +1936,14 @@ protected:
 					if(!header)
 						MISS_COUNT(accesses[i]) = 1;
 					else {
-						MISS_COUNT(accesses[i]) = MAX_ITERATION(header);
+						MISS_COUNT(accesses[i]) = pman->poly().maxIteration(pman->poly().header(header));
 						RELATIVE_TO(accesses[i]) = header;
 					}
+					if(sweep) {
+						genstruct::Vector<way_result_t>& w = *WAY_RESULTS(accesses[i]);
+						for(int k = 0; k < w.length(); k++)
+							w[k].miss = MISS_COUNT(accesses[i]);
+					}
 				}
 
 				// debug
@@ -727,20 +2007,425 @@ protected:
 	}
 
 private:
-	typedef PIDManager::t t;
 
-	void process(WorkSpace *ws, CFG *cfg, int set) {
-		if(logFor(LOG_FILE))
-			log << "\tset " << set << io::endl;
-		QDCACHE_DEBUG(cerr << "\n====== SET " << set << " ======\n");
+	// task recording its join counters
+	class AnalysisTask: public Scheduler::Task {
+	public:
+		inline AnalysisTask(void): trivial(false) { }
+		join_stat_t stat;
+		bool trivial;
+	};
+
+	// analysis of a CFG for one cache set
+	class SetTask: public AnalysisTask {
+	public:
+		inline SetTask(PIDCacheAnalysis& analysis, Poly& poly, RefManager& rman, CFG *cfg, const CFGInfo *info,
+			const ConflictGraph *graph, int set, genstruct::Vector<result_t> *results, acs_stat_t *acs)
+			: ana(analysis), _poly(poly), _rman(rman), _cfg(cfg), _info(info), _graph(graph), _set(set), _results(results), _acs(acs) { }
+		virtual void run(void) {
+			QDCACHE_DEBUG(cerr << "\n====== SET " << _set << " ======\n");
+			if(!ana.sweep && ana.classifyTrivial(_cfg, _info, _set, _rman, _results)) {
+				trivial = true;
+				return;
+			}
+			if(ana.dense) {
+				DenseManager man(_cfg, _info, _set, _poly, _rman, ana.dense, _graph);
+				man.sweepWays(ana.sweep);
+				if(man.fits()) {
+					ana.analyze(man, _cfg, _info, _results);
+#					ifdef DENSE_CHECK
+						ana.checkDense(_cfg, _info, _set, _poly, _rman, _graph, _results);
+#					endif
+					return;
+				}
+			}
+
+			// list engine specialized for the common geometries (ways, block bits, set bits)
+			const hard::Cache& cache = _rman.cache();
+			if(StaticGeometry<2, 4, 3>::matches(cache))
+				ana.analyzeSet<StaticGeometry<2, 4, 3> >(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+			else if(StaticGeometry<2, 5, 7>::matches(cache))
+				ana.analyzeSet<StaticGeometry<2, 5, 7> >(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+			else if(StaticGeometry<4, 5, 7>::matches(cache))
+				ana.analyzeSet<StaticGeometry<4, 5, 7> >(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+			else if(StaticGeometry<4, 6, 6>::matches(cache))
+				ana.analyzeSet<StaticGeometry<4, 6, 6> >(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+			else if(StaticGeometry<8, 6, 6>::matches(cache))
+				ana.analyzeSet<StaticGeometry<8, 6, 6> >(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+			else
+				ana.analyzeSet<RuntimeGeometry>(_cfg, _info, _set, _poly, _rman, _graph, _results, stat, _acs);
+		}
+	private:
+		PIDCacheAnalysis& ana;
+		Poly& _poly;
+		RefManager& _rman;
+		CFG *_cfg;
+		const CFGInfo *_info;
+		const ConflictGraph *_graph;
+		int _set;
+		genstruct::Vector<result_t> *_results;
+		acs_stat_t *_acs;
+	};
+
+	// analysis of a CFG for all cache sets at once
+	class CFGTask: public AnalysisTask {
+	public:
+		inline CFGTask(PIDCacheAnalysis& analysis, Poly& poly, RefManager& rman, CFG *cfg, const CFGInfo *info,
+			const ConflictGraph *graph, genstruct::Vector<result_t> *results, acs_stat_t *acs)
+			: ana(analysis), _poly(poly), _rman(rman), _cfg(cfg), _info(info), _graph(graph), _results(results), _acs(acs) { }
+		virtual void run(void) {
+			MultiSetManager man(_cfg, ana.cache->setCount(), _poly, _rman, _graph);
+			man.sweepWays(ana.sweep);
+			ana.analyze(man, _cfg, _info, _results);
+			stat = man.joinStat();
+			for(int i = 0; i < ana.cache->setCount(); i++)
+				_acs[i] = man.acsStat(i);
+		}
+	private:
+		PIDCacheAnalysis& ana;
+		Poly& _poly;
+		RefManager& _rman;
+		CFG *_cfg;
+		const CFGInfo *_info;
+		const ConflictGraph *_graph;
+		genstruct::Vector<result_t> *_results;
+		acs_stat_t *_acs;
+	};
+
+	/**
+	 * Classify the accesses of a set without computing the ACS when no
+	 * eviction is possible in the set: all accesses concerning it are cached
+	 * accesses to constant addresses and they use at most A distinct blocks.
+	 * Each block is then loaded at most once: an access is ALWAYS_HIT if its
+	 * block has been accessed on all paths before it, else FIRST_MISS (if it
+	 * is in a loop or its block may have been accessed before) with one miss,
+	 * else NOT_CLASSIFIED with one miss (as an always miss).
+	 * The blocks accessed before the accesses are obtained by a must/may
+	 * pass on bit masks (one bit per block).
+	 * @param cfg		CFG to look in.
+	 * @param info		Information of the CFG.
+	 * @param set		Cache set.
+	 * @param rman		Reference manager.
+	 * @param results	To store results in (in BB then access order).
+	 * @return			True if the set has been classified, false if it
+	 * 					needs the full analysis.
+	 */
+	bool classifyTrivial(CFG *cfg, const CFGInfo *info, int set, RefManager& rman, genstruct::Vector<result_t> *results) {
+		typedef elm::t::uint32 mask_t;
+		if(cache->wayCount() > int(sizeof(mask_t) * 8))
+			return false;
+
+		// number the blocks of the set
+		genstruct::HashTable<RefManager::address_t, int> blocks;
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			const Bag<PolyAccess>& accesses = info->accesses(bb);
+			for(int i = 0; i < accesses.count(); i++) {
+				Poly::t r = accesses[i].ref();
+				if(r == Poly::top)
+					return false;
+				if(!rman.concerns(r, set))
+					continue;
+				if(!accesses[i].cached() || r->h)
+					return false;
+				RefManager::address_t a = cache->block(RefManager::address_t(r->c));
+				if(!blocks.hasKey(a)) {
+					if(blocks.count() == cache->wayCount())
+						return false;
+					blocks.put(a, blocks.count());
+				}
+			}
+		}
+
+		// compute the blocks accessed on all paths (must) and some path (may) at BB output
+		int n = cfg->countBB();
+		mask_t *gen = new mask_t[n], *must = new mask_t[n], *may = new mask_t[n];
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			gen[bb->number()] = 0;
+			const Bag<PolyAccess>& accesses = info->accesses(bb);
+			for(int i = 0; i < accesses.count(); i++)
+				if(rman.concerns(accesses[i].ref(), set))
+					gen[bb->number()] |= mask_t(1) << blocks.get(cache->block(RefManager::address_t(accesses[i].ref()->c)), 0);
+			must[bb->number()] = *bb == cfg->entry() ? gen[bb->number()] : ~mask_t(0);
+			may[bb->number()] = gen[bb->number()];
+		}
+		for(bool changed = true; changed; ) {
+			changed = false;
+			for(CFG::BBIterator bb(cfg); bb; bb++) {
+				if(*bb == cfg->entry())
+					continue;
+				mask_t mu = ~mask_t(0), ma = 0;
+				for(BasicBlock::InIterator in(bb); in; in++) {
+					mu &= must[in->source()->number()];
+					ma |= may[in->source()->number()];
+				}
+				mu |= gen[bb->number()];
+				ma |= gen[bb->number()];
+				if(mu != must[bb->number()] || ma != may[bb->number()]) {
+					must[bb->number()] = mu;
+					may[bb->number()] = ma;
+					changed = true;
+				}
+			}
+		}
+
+		// classify the accesses
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			mask_t mu = 0, ma = 0;
+			if(*bb != cfg->entry()) {
+				mu = ~mask_t(0);
+				for(BasicBlock::InIterator in(bb); in; in++) {
+					mu &= must[in->source()->number()];
+					ma |= may[in->source()->number()];
+				}
+			}
+			bool looped = info->innermost(bb) != 0;
+			const Bag<PolyAccess>& accesses = info->accesses(bb);
+			for(int i = 0; i < accesses.count(); i++) {
+				result_t r;
+				if(rman.concerns(accesses[i].ref(), set)) {
+					mask_t b = mask_t(1) << blocks.get(cache->block(RefManager::address_t(accesses[i].ref()->c)), 0);
+					if(mu & b) {
+						r.stat.ah++;
+						r.cat = cache::ALWAYS_HIT;
+					}
+					else if(looped || (ma & b)) {
+						r.stat.pe++;
+						r.cat = cache::FIRST_MISS;
+						r.miss = 1;
+					}
+					else {
+						r.stat.am++;
+						r.cat = cache::NOT_CLASSIFIED;
+						r.miss = 1;
+					}
+					mu |= b;
+					ma |= b;
+				}
+				results->add(r);
+			}
+		}
+		delete [] gen;
+		delete [] must;
+		delete [] may;
+		return true;
+	}
+
+	/**
+	 * Compute the signature of a cache set, that is, for each access of the CFG
+	 * concerning the set (in BB then access order), its BB, if it is cached
+	 * and the block it accesses, numbered in the order of first access.
+	 * The other accesses do not change the state of the set: two sets with
+	 * the same signature see the same sequence of accesses up to a renaming
+	 * of their blocks and the k-th access concerning one set gets the same
+	 * category and miss count as the k-th access concerning the other.
+	 * The positions of these accesses (in the whole CFG) are recorded to map
+	 * the results of one set to the other.
+	 *
+	 * Only the sets whose accesses have constant (or T) references get
+	 * a signature: the closed-form and enumerated counts of the array
+	 * references depend on the set itself.
+	 * @param cfg	CFG to look in.
+	 * @param set	Cache set.
+	 * @param rman	Reference manager.
+	 * @param sig	To store the signature in.
+	 * @param pos	To store the positions of the accesses concerning the set in.
+	 * @return		True if the signature has been built, false if the set
+	 * 				has to be analyzed on its own.
+	 */
+	bool signature(CFG *cfg, int set, RefManager& rman, genstruct::Vector<int>& sig, genstruct::Vector<int>& pos) {
+		genstruct::HashTable<RefManager::address_t, int> blocks;
+		int k = 0;
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			const Bag<PolyAccess>& accesses = *ACCESSES(bb);
+			for(int i = 0; i < accesses.count(); i++, k++) {
+				Poly::t r = accesses[i].ref();
+				if(!rman.concerns(r, set))
+					continue;
+				int b = -1;
+				if(r != Poly::top) {
+					if(r->h)
+						return false;
+					RefManager::address_t a = cache->block(RefManager::address_t(r->c));
+					b = blocks.get(a, -1);
+					if(b < 0) {
+						b = blocks.count();
+						blocks.put(a, b);
+					}
+				}
+				sig.add(bb->number());
+				sig.add(accesses[i].cached());
+				sig.add(b);
+				pos.add(k);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Test if two set signatures are equal.
+	 * @param s1	First signature.
+	 * @param s2	Second signature.
+	 * @return		True if they are equal, false else.
+	 */
+	static bool sameSignature(const genstruct::Vector<int>& s1, const genstruct::Vector<int>& s2) {
+		if(s1.length() != s2.length())
+			return false;
+		for(int i = 0; i < s1.length(); i++)
+			if(s1[i] != s2[i])
+				return false;
+		return true;
+	}
+
+	void cleanTasks(void) {
+		for(int i = 0; i < tasks.length(); i++)
+			delete tasks[i];
+		tasks.clear();
+		copies.clear();
+		for(int i = 0; i < graphs.length(); i++)
+			delete graphs[i];
+		graphs.clear();
+		for(int i = 0; i < infos.length(); i++)
+			delete infos[i];
+		infos.clear();
+		firsts.clear();
+		delete [] results;
+		results = 0;
+		delete [] acs;
+		acs = 0;
+		delete [] positions;
+		positions = 0;
+	}
+
+	/**
+	 * Merge the results of a set analysis into the accesses.
+	 * @param cfg		Analyzed CFG.
+	 * @param results	Results of the set analysis (in BB then access order).
+	 */
+	void merge(CFG *cfg, const genstruct::Vector<result_t>& results) {
+		int k = 0;
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			Bag<PolyAccess>& accesses = *ACCESSES(bb);
+			for(int i = 0; i < accesses.count(); i++, k++) {
+				const result_t& r = results[k];
+				if(r.miss ==  UNBOUNDED)
+					MISS_COUNT(accesses[i]) = UNBOUNDED;
+				else
+					MISS_COUNT(accesses[i]) += r.miss;
+				if(r.stat.total()) {
+					stat_t& s = *STAT(accesses[i]);
+					s.am += r.stat.am;
+					s.ah += r.stat.ah;
+					s.mm += r.stat.mm;
+					s.nc += r.stat.nc;
+					s.pe += r.stat.pe;
+				}
+				if(r.cat != cache::INVALID_CATEGORY)
+					PIDManager::assignCat(accesses[i], r.cat);
+			}
+		}
+	}
+
+	/**
+	 * Merge the results of a set analysis for one associativity
+	 * into the @ref WAY_RESULTS of the accesses (sweep mode).
+	 * @param cfg		Analyzed CFG.
+	 * @param results	Results of the set analysis for this associativity (in BB then access order).
+	 * @param way		Index of the associativity (associativity - 1).
+	 */
+	void mergeWays(CFG *cfg, const genstruct::Vector<result_t>& results, int way) {
+		int k = 0;
+		for(CFG::BBIterator bb(cfg); bb; bb++) {
+			Bag<PolyAccess>& accesses = *ACCESSES(bb);
+			for(int i = 0; i < accesses.count(); i++, k++) {
+				const result_t& r = results[k];
+				genstruct::Vector<way_result_t>& w = *WAY_RESULTS(accesses[i]);
+				while(w.length() <= way)
+					w.add(way_result_t());
+				if(r.miss == UNBOUNDED || w[way].miss == UNBOUNDED)
+					w[way].miss = UNBOUNDED;
+				else
+					w[way].miss += r.miss;
+				w[way].cat = PIDManager::joinCat(w[way].cat, r.cat);
+			}
+		}
+	}
+
+	/**
+	 * Perform the analysis of a CFG for one set with the list engine
+	 * specialized for the given cache geometry.
+	 * @param cfg		Analyzed CFG.
+	 * @param info		Information of the CFG.
+	 * @param set		Analyzed set.
+	 * @param poly		Poly domain.
+	 * @param rman		Reference manager.
+	 * @param graph		Conflict graph of the references of the CFG.
+	 * @param results	To store results in (one vector per associativity in sweep mode).
+	 * @param stat		To store join counters in.
+	 * @param acs		To store ACS length statistics in.
+	 */
+	template <class G>
+	void analyzeSet(CFG *cfg, const CFGInfo *info, int set, Poly& poly, RefManager& rman, const ConflictGraph *graph,
+	genstruct::Vector<result_t> *results, join_stat_t& stat, acs_stat_t *acs) {
+		BasicPIDManager<G> man(set, poly, rman, graph);
+		man.sweepWays(sweep);
+		analyze(man, cfg, info, results);
+		stat = man.joinStat();
+		*acs = man.acsStat();
+	}
+
+#	ifdef DENSE_CHECK
+	/**
+	 * Check that the list engine finds the same results as the dense engine
+	 * for a CFG and a set (debugging of the dense engine).
+	 * @param cfg		Analyzed CFG.
+	 * @param info		Information of the CFG.
+	 * @param set		Analyzed set.
+	 * @param poly		Poly domain.
+	 * @param rman		Reference manager.
+	 * @param graph		Conflict graph of the references of the CFG.
+	 * @param results	Results of the dense engine (one vector per associativity in sweep mode).
+	 */
+	void checkDense(CFG *cfg, const CFGInfo *info, int set, Poly& poly, RefManager& rman, const ConflictGraph *graph,
+	const genstruct::Vector<result_t> *results) {
+		genstruct::Vector<result_t> *check = new genstruct::Vector<result_t>[nres];
+		join_stat_t stat;
+		acs_stat_t acs;
+		analyzeSet<RuntimeGeometry>(cfg, info, set, poly, rman, graph, check, stat, &acs);
+		for(int i = 0; i < nres; i++) {
+			ASSERT(check[i].length() == results[i].length());
+			for(int j = 0; j < results[i].length(); j++)
+				if(check[i][j].miss != results[i][j].miss || check[i][j].cat != results[i][j].cat) {
+					cerr << "DENSE CHECK: " << cfg->label() << ", set " << set << ", access " << j
+						 << ": dense " << results[i][j].cat << " (" << results[i][j].miss << ")"
+						 << " != list " << check[i][j].cat << " (" << check[i][j].miss << ")\n";
+					ASSERTP(false, "dense and list engines disagree");
+				}
+		}
+		delete [] check;
+	}
+#	endif
+
+	/**
+	 * Perform the analysis of a CFG with the given manager, either
+	 * a PIDManager (one set) or a MultiSetManager (all sets).
+	 * As it may be run in parallel with other analyses, it does not modify the
+	 * properties of the accesses but records its results in the given vectors.
+	 * The properties of the CFG are read from info, not from the blocks and edges.
+	 * @param man		Manager to use.
+	 * @param cfg		Analyzed CFG.
+	 * @param info		Information of the CFG.
+	 * @param results	To store results in (one vector per set of the manager,
+	 * 					in BB then access order).
+	 */
+	template <class M>
+	void analyze(M& man, CFG *cfg, const CFGInfo *info, genstruct::Vector<result_t> *results) {
+		typedef typename M::t t;
 
 		// prepare the analysis
-		PolyManager *pman = POLY_MANAGER(ws);
-		ASSERT(pman);
-		PIDManager man(set, pman->poly(), **REF_MANAGER(ws));
+		man.prune(cfg, info);
 		ai::CFGGraph graph(cfg);
-		ai::EdgeStore<PIDManager, ai::CFGGraph> store(man, graph);
-		ai::WorkListDriver<PIDManager, ai::CFGGraph, ai::EdgeStore<PIDManager, ai::CFGGraph> >
+		ai::EdgeStore<M, ai::CFGGraph> store(man, graph);
+		ai::WorkListDriver<M, ai::CFGGraph, ai::EdgeStore<M, ai::CFGGraph> >
 			iter(man, graph, store);
 		iter.changeAll();
 
@@ -751,24 +2436,21 @@ private:
 			// apply update
 			t s = iter.input();
 			QDCACHE_DEBUG(man.dump(cerr, s));
-			QDCACHE_DO_CHECK(s);
-			Bag<PolyAccess>& accesses = *ACCESSES(*iter);
-			for(int i = 0; i < accesses.count(); i++) {
-				s = man.update(*iter, accesses[i], s);
-					QDCACHE_DO_CHECK(s);
-			}
+			s = man.update(*iter, info->accesses(*iter), s);
 
 			// refine result according to edges
-			for(BasicBlock::OutIterator out(*iter); out; out++) {
+			const genstruct::Vector<CFGInfo::edge_t>& outs = info->outs(*iter);
+			for(int i = 0; i < outs.length(); i++) {
+				Edge *out = outs[i].edge;
 				t ss;
-				if(BACK_EDGE(out)) {
+				if(outs[i].back) {
 					QDCACHE_DEBUG(cerr << "back: ");
 					ss = man.back(s);
 				}
-				else if(LOOP_EXIT_EDGE(out)) {
+				else if(outs[i].exit) {
 					QDCACHE_DEBUG(cerr << "leave: ");
-					BasicBlock* innmost_lh = LOOP_HEADER(*iter) ? *iter : ENCLOSING_LOOP_HEADER(*iter);
-					const BasicBlock* outmost_lh = LOOP_EXIT_EDGE(out); // contains header of outmost loop
+					BasicBlock* innmost_lh = info->innermost(*iter);
+					const BasicBlock* outmost_lh = outs[i].exit; // contains header of outmost loop
 					bool first = true;
 					do
 					{
@@ -776,18 +2458,17 @@ private:
 							first = false;
 							ss = man.leave(s, innmost_lh);
 						} else {
-							innmost_lh = ENCLOSING_LOOP_HEADER(innmost_lh);
+							innmost_lh = info->enclosing(innmost_lh);
 							ss = man.leave(ss, innmost_lh); 
 						}
 					} while(innmost_lh != outmost_lh);
 				}
-				else if(LOOP_HEADER(out->target())) {
+				else if(info->isHeader(out->target())) {
 					QDCACHE_DEBUG(cerr << "enter: ");
-					ss = man.enter(s);
+					ss = man.enter(s, out->target());
 				}
 				else
 					ss = s;
-				QDCACHE_DO_CHECK(ss);
 				iter.check(out, ss);
 				QDCACHE_DEBUG(cerr << "-> " << *out << io::endl; man.dump(cerr, ss););
 			}
@@ -797,20 +2478,24 @@ private:
 		}
 
 		// use analysis results
-		for(CFG::BBIterator bb(cfg); bb; bb++) {
-			t s = iter.input(bb);
-			Bag<PolyAccess>& accesses = *ACCESSES(bb);
-			for(int i = 0; i < accesses.count(); i++) {
-				miss_count_t c = man.countMisses(accesses[i], s);
-				if(c ==  UNBOUNDED)
-					MISS_COUNT(accesses[i]) = UNBOUNDED;
-				else
-					MISS_COUNT(accesses[i]) += c;
-				s = man.update(*iter, accesses[i], s);
-			}
-		}
+		for(CFG::BBIterator bb(cfg); bb; bb++)
+			man.collect(bb, info->accesses(bb), iter.input(bb), results);
 	}
 
+	const hard::Cache *cache;
+	int jobs;
+	bool multi;
+	int dense;
+	bool sweep;
+	int nres;
+	genstruct::Vector<AnalysisTask *> tasks;
+	genstruct::Vector<CFGInfo *> infos;
+	genstruct::Vector<ConflictGraph *> graphs;
+	genstruct::Vector<Pair<int, int> > copies;
+	genstruct::Vector<result_t> *results;
+	acs_stat_t *acs;
+	genstruct::Vector<int> *positions;
+	genstruct::HashTable<CFG *, int> firsts;
 };
 
 p::declare PIDCacheAnalysis::reg = p::init("otawa::pidcache::PIDCacheAnalysis", Version(1, 0, 0))
@@ -826,5 +2511,60 @@ p::feature ANALYSIS_FEATURE("otawa::pidcache::ANALYSIS_FEATURE", new Maker<PIDCa
 Identifier<miss_count_t> MISS_COUNT("otawa::pidcache::MISS_COUNT", 0);
 Identifier<BasicBlock *> RELATIVE_TO("otawa::pidcache::RELATIVE_TO", 0);
 
+/**
+ * Configuration property giving the number of threads used to analyze
+ * the (CFG, cache set) pairs. The results do not depend on this number.
+ *
+ * @p Features
+ * @li @ref ANALYSIS_FEATURE
+ */
+Identifier<int> JOBS("otawa::pidcache::JOBS", 1);
+
+/**
+ * Configuration property selecting the multi-set engine: all cache sets
+ * of a CFG are analyzed in one traversal instead of one traversal per set.
+ * The results are the same as the per-set engine.
+ *
+ * @p Features
+ * @li @ref ANALYSIS_FEATURE
+ */
+Identifier<bool> MULTI_SET("otawa::pidcache::MULTI_SET", false);
+
+/**
+ * Configuration property enabling the dense engine for the per-set
+ * analyses: the sets whose universe of references is not bigger than this
+ * limit represent their states as arrays of ages instead of lists.
+ * The other sets (and the multi-set engine) keep the list engine.
+ * 0 disables the dense engine.
+ *
+ * @p Features
+ * @li @ref ANALYSIS_FEATURE
+ */
+Identifier<int> DENSE_LIMIT("otawa::pidcache::DENSE_LIMIT", 0);
+
+/**
+ * Configuration property enabling the associativity sweep: the ages are
+ * computed once for the associativity A of the data cache and the accesses
+ * are classified for every associativity from 1 to A (LRU inclusion).
+ * The results for A are the usual ones; the results for the lower
+ * associativities are put in @ref WAY_RESULTS.
+ *
+ * @p Features
+ * @li @ref ANALYSIS_FEATURE
+ */
+Identifier<bool> WAY_SWEEP("otawa::pidcache::WAY_SWEEP", false);
+
+/**
+ * Results of an access for each associativity (indexed by associativity - 1)
+ * when @ref WAY_SWEEP is enabled.
+ *
+ * @p Hooks
+ * @li @ref PolyAccess
+ *
+ * @p Features
+ * @li @ref ANALYSIS_FEATURE
+ */
+Identifier<genstruct::Vector<way_result_t> > WAY_RESULTS("otawa::pidcache::WAY_RESULTS");
+
 } }	// otawa::pidcache
 
@@ -19,9 +19,10 @@
  *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <string.h>
 #include <elm/util/array.h>
 #include <otawa/util/FlowFactLoader.h>
-#include <otawa/util/Dominance.h>
+#include <otawa/cfg/CFG.h>
 #include <otawa/cfg/Edge.h>
 #include <elm/log/Log.h>
 #include "Poly.h"
@@ -31,6 +32,222 @@ namespace otawa { namespace pidcache {
 Poly::pair_t Poly::top[] = { };
 Poly::pair_t Poly::bot[] = { };
 
+
+/**
+ * @class Poly
+ * Domain of the Poly analysis. The values are hash-consed: each value is
+ * built only once and structurally equal values share the same storage,
+ * so that equality is a pointer comparison. The hash-consing table is
+ * protected by a mutex and the values may be built from several threads.
+ *
+ * A value is an array of terms (coefficient, loop header index) sorted
+ * in the reverse loop order and ended by the constant term, whose header
+ * index is 0. Each term takes 8 bytes.
+ */
+
+
+/**
+ * Build the domain.
+ * @param alloc		Allocator for the values.
+ */
+Poly::Poly(StackAllocator& alloc)
+: allocator(alloc), mutex(sys::Mutex::make()), htab(0), hsize(256), hcount(0), loops(0) {
+	htab = new node_t *[hsize];
+	for(int i = 0; i < hsize; i++)
+		htab[i] = 0;
+}
+
+
+/**
+ */
+Poly::~Poly(void) {
+	delete [] htab;
+	delete [] loops;
+	delete mutex;
+}
+
+
+/**
+ * Build the loop table of the given CFGs, indexed by header index
+ * (see header()): it provides the loop order used to sort the terms of
+ * the values and the iteration bounds of the loop headers. The blocks
+ * are numbered across the whole collection so that the header indexes
+ * of different CFGs never collide.
+ *
+ * The loop order is a reverse post-order of each CFG: a header dominating
+ * another one always precedes it.
+ * @param coll	CFGs the values are computed for.
+ */
+void Poly::setLoops(const CFGCollection& coll) {
+
+	// number the blocks of the collection
+	int n = 0;
+	heads.clear();
+	for(int i = 0; i < coll.count(); i++)
+		for(CFG::BBIterator bb(coll.get(i)); bb; bb++)
+			heads.put(bb, ++n);
+	delete [] loops;
+	loops = new loop_t[n + 1];
+	for(int i = 0; i <= n; i++) {
+		loops[i].bb = 0;
+		loops[i].order = -1;
+	}
+
+	// compute the post-order of each CFG (order is used as visit mark)
+	genstruct::Vector<BasicBlock *> stack;
+	int post = n;
+	for(int i = 0; i < coll.count(); i++) {
+		stack.push(coll.get(i)->entry());
+		loops[header(coll.get(i)->entry())].order = 0;
+		while(stack) {
+			BasicBlock *bb = stack.top();
+			bool pushed = false;
+			for(BasicBlock::OutIterator e(bb); e && !pushed; e++)
+				if(e->target() && loops[header(e->target())].order < 0) {
+					loops[header(e->target())].order = 0;
+					stack.push(e->target());
+					pushed = true;
+				}
+			if(!pushed)
+				loops[header(stack.pop())].order = --post;
+		}
+	}
+
+	// record the blocks and the iteration bounds
+	for(int i = 0; i < coll.count(); i++)
+		for(CFG::BBIterator bb(coll.get(i)); bb; bb++) {
+			loop_t& l = loops[header(bb)];
+			l.bb = bb;
+			l.max = MAX_ITERATION(bb);
+			l.min = MIN_ITERATION(bb);
+		}
+}
+
+
+/**
+ * @fn Poly::header_t Poly::header(BasicBlock *bb) const;
+ * Get the index of a loop header as stored in the terms of the values.
+ * Index 0 is reserved to mark the constant term. The indexes are unique
+ * over the CFG collection passed to setLoops().
+ * @param bb	Loop header.
+ * @return		Header index.
+ */
+
+
+/**
+ * @fn BasicBlock *Poly::block(header_t h) const;
+ * Get the loop header matching a header index.
+ * @param h		Header index.
+ * @return		Loop header.
+ */
+
+
+/**
+ * @fn int Poly::maxIteration(header_t h) const;
+ * Get the maximum number of iterations of a loop.
+ * @param h		Loop header index.
+ * @return		Maximum number of iterations (-1 if unknown).
+ */
+
+
+/**
+ * @fn int Poly::minIteration(header_t h) const;
+ * Get the minimum number of iterations of a loop.
+ * @param h		Loop header index.
+ * @return		Minimum number of iterations (-1 if unknown).
+ */
+
+
+/**
+ * @fn bool Poly::precedes(header_t h1, header_t h2) const;
+ * Test if a loop header precedes another one in the loop order
+ * (if h1 dominates h2, h1 precedes h2). The terms of the values
+ * are sorted in the reverse of this order.
+ * @param h1	First header index.
+ * @param h2	Second header index.
+ * @return		True if h1 precedes h2.
+ */
+
+
+/**
+ * Compute the hash code of a value.
+ * @param v		Value to hash (ended by a constant term).
+ * @return		Hash code.
+ */
+elm::t::uint32 Poly::hash(const pair_t *v) {
+	elm::t::uint32 h = 2166136261u;
+	while(true) {
+		h = (h ^ elm::t::uint32(v->c)) * 16777619u;
+		h = (h ^ v->h) * 16777619u;
+		if(!v->h)
+			return h;
+		v++;
+	}
+}
+
+
+/**
+ * @fn int Poly::length(t v);
+ * Get the number of terms (constant term included) of a unique value.
+ * The length is stored in the slot preceding the first term.
+ * @param v		Unique value (not top, bottom or a sub-value).
+ * @return		Number of terms.
+ */
+
+
+/**
+ * Get the unique instance of a value. The unique instances are stored
+ * with their exact size, preceded by their length.
+ * @param v		Value (possibly temporary) to look for.
+ * @return		Unique instance of the value.
+ */
+Poly::t Poly::intern(const pair_t *v) {
+	elm::t::uint32 h = hash(v);
+	int n = 1;
+	while(v[n - 1].h)
+		n++;
+	mutex->lock();
+
+	// look in the table
+	for(node_t *node = htab[h & (hsize - 1)]; node; node = node->next)
+		if(node->hash == h && length(node->val) == n
+		&& !memcmp(node->val, v, n * sizeof(pair_t))) {
+			mutex->unlock();
+			return node->val;
+		}
+
+	// grow the table if needed
+	if(hcount >= hsize * 2) {
+		int nsize = hsize * 2;
+		node_t **ntab = new node_t *[nsize];
+		for(int i = 0; i < nsize; i++)
+			ntab[i] = 0;
+		for(int i = 0; i < hsize; i++)
+			for(node_t *node = htab[i], *next; node; node = next) {
+				next = node->next;
+				node->next = ntab[node->hash & (nsize - 1)];
+				ntab[node->hash & (nsize - 1)] = node;
+			}
+		delete [] htab;
+		htab = ntab;
+		hsize = nsize;
+	}
+
+	// build the new value
+	t r = t(allocator.allocate(sizeof(pair_t) * (n + 1)));
+	r[0] = pair_t(n, 0);
+	r++;
+	memcpy(r, v, n * sizeof(pair_t));
+	node_t *node = static_cast<node_t *>(allocator.allocate(sizeof(node_t)));
+	node->hash = h;
+	node->val = r;
+	node->next = htab[h & (hsize - 1)];
+	htab[h & (hsize - 1)] = node;
+	hcount++;
+	mutex->unlock();
+	return r;
+}
+
 /**
  * Convert a value to an address.
  * @param v		Value to convert.
@@ -50,7 +267,7 @@ bool Poly::toAddress(t v, address_t& base, address_t& top, ot::size& off) {
 		address_t pos = 0, neg = 0;
 		pair_t *p;
 		for(p = v; p->h; p++) {
-			int n = MAX_ITERATION(p->h);
+			int n = maxIteration(p->h);
 			if(n < 0)
 				return false;
 			if(n != 0) {
@@ -75,8 +292,8 @@ bool Poly::toAddress(t v, address_t& base, address_t& top, ot::size& off) {
 bool Poly::isTopPrecise(t v) {
 	ASSERT(v != Poly::top && v != Poly::bot);
 	while(v->h) {
-		int min = MIN_ITERATION(v->h);
-		int max = MAX_ITERATION(v->h);
+		int min = minIteration(v->h);
+		int max = maxIteration(v->h);
 		if(min < 0 || min != max)
 			return false;
 		v++;
@@ -93,7 +310,7 @@ Poly::coef_t Poly::count(t v) {
 	coef_t cnt = 1;
 	t p = v;
 	while(p->h) {
-		int max = MAX_ITERATION(p->h);
+		int max = maxIteration(p->h);
 		if(max >= 0)
 			cnt *= max;
 		else {
@@ -171,9 +388,8 @@ Poly::coef_t Poly::looselyMul(coef_t v1, coef_t v2, bool & lost) {
 
 
 Poly::t Poly::make(coef_t c) {
-	t r = t(allocator.allocate(sizeof(pair_t)));
-	*r = pair_t(c, 0);
-	return r;
+	pair_t r(c, 0);
+	return intern(&r);
 }
 
 
@@ -201,7 +417,7 @@ Poly::t Poly::add(t p1, t p2) {
 	else if(p1 == top || p2 == top)
 		return top;
 	else {
-		t r = allocate(), p = r;
+		pair_t r[cap], *p = r;
 		bool lost;
 		while(p1->h || p2->h) {
 			if(p1->h == p2->h) {
@@ -214,7 +430,7 @@ Poly::t Poly::add(t p1, t p2) {
 				p2++;
 			}
 			else if(p1->h && p2->h) {
-				if(Dominance::dominates(p1->h, p2->h))
+				if(precedes(p1->h, p2->h))
 					*p++ = *p2++;
 				else
 					*p++ = *p1++;
@@ -227,7 +443,7 @@ Poly::t Poly::add(t p1, t p2) {
 				throw MessageException("Poly: too complex polynom");
 		}
 		*p = pair_t(p1->c + p2->c, 0);
-		return r;
+		return intern(r);
 	}
 }
 
@@ -240,7 +456,7 @@ Poly::t Poly::sub(t p1, t p2) {
 	else if(p1 == top || p2 == top)
 		return top;
 	else {
-		t r = allocate(), p = r;
+		pair_t r[cap], *p = r;
 		bool lost;
 		while(p1->h || p2->h) {
 			if(p1->h == p2->h) {
@@ -253,7 +469,7 @@ Poly::t Poly::sub(t p1, t p2) {
 				p2++;
 			}
 			else if(p1->h && p2->h) {
-				if(Dominance::dominates(p1->h, p2->h))
+				if(precedes(p1->h, p2->h))
 					*p++ = *p2++;
 				else
 					*p++ = *p1++;
@@ -266,7 +482,7 @@ Poly::t Poly::sub(t p1, t p2) {
 				throw MessageException("Poly: too complex polynom");
 		}
 		*p = pair_t(p1->c - p2->c, 0);
-		return r;
+		return intern(r);
 	}
 }
 
@@ -279,7 +495,7 @@ Poly::t Poly::shl(t p1, t p2) {
 	else if(p1 == top || p2 == top || p2[0].c >= 31)
 		return top;
 	else {
-		t p = allocate();
+		pair_t p[cap];
 		bool done = false, lost;
 		for(int i = 0; !done; i++) {
 			p[i] = pair_t(looselyShl(p1[i].c, p2[0].c, lost), p1[i].h);
@@ -287,7 +503,7 @@ Poly::t Poly::shl(t p1, t p2) {
 				return top;
 			done = !p1[i].h;
 		}
-		return p;
+		return intern(p);
 	}
 }
 
@@ -300,7 +516,7 @@ Poly::t Poly::mul(t p1, t p2) {
 	else if(p1 == top || p2 == top)
 		return top;
 	else if(!p2[0].h) {
-		t p = allocate();
+		pair_t p[cap];
 		bool done = false, lost;
 		for(int i = 0; !done; i++) {
 			p[i] = pair_t(looselyMul(p1[i].c, p2[0].c, lost), p1[i].h);
@@ -308,7 +524,7 @@ Poly::t Poly::mul(t p1, t p2) {
 				return top;
 			done = !p1[i].h;
 		}
-		return p;
+		return intern(p);
 	}
 	else if(!p1[0].h)
 		return mul(p2, p1);
@@ -318,11 +534,21 @@ Poly::t Poly::mul(t p1, t p2) {
 
 
 /**
- * Test whether both values are equal.
+ * @fn bool Poly::equals(t p1, t p2) const;
+ * Test whether both values are equal. As values are hash-consed,
+ * this is a pointer comparison: it must not be used with temporary
+ * values or sub-values (as p + 1).
+ * @param v1	First value.
+ * @param v2	Second value.
+ */
+
+
+/**
+ * Structural equality test, to use with temporary values or sub-values.
  * @param v1	First value.
  * @param v2	Second value.
  */
-bool Poly::equals(t p1, t p2) const {
+bool Poly::same(t p1, t p2) const {
 	if(p1 == p2)
 		return true;
 	if(p1 == bot || p2 == bot || p1 == top || p2 == top)
@@ -365,7 +591,7 @@ bool Poly::includes(t set, t sub) {
 	else if(!set->h)
 		return false;
 	else
-		return equals(set + 1, sub);
+		return same(set + 1, sub);
 }
 
 
@@ -395,15 +621,21 @@ Poly::t Poly::exwiden(BasicBlock *h, t prev, t next) {
 		else {
 			if(k[0].h)
 				r = top;
-			else if(next->h == h && next->c == k[0].c)	// a \/ b = a + ki if b - a = k and ki not in a
+			else if(next->h == header(h) && next->c == k[0].c)	// a \/ b = a + ki if b - a = k and ki not in a
 				r = prev;
 			else {										// a \/ b = b if b - a = k and kin in a
-				r = allocate();
-				r[0] = pair_t(k[0].c, h);
-				int i;
-				for(i = 0; prev[i].h; i++)
-					r[i + 1] = prev[i];
-				r[i + 1] = prev[i];
+				int n = 0;
+				while(prev[n].h)
+					n++;
+				if(n + 2 > cap)							// no room for the new term
+					r = top;
+				else {
+					pair_t v[cap];
+					v[0] = pair_t(k[0].c, header(h));
+					for(int i = 0; i <= n; i++)
+						v[i + 1] = prev[i];
+					r = intern(v);
+				}
 			}
 		}
 	}
@@ -428,7 +660,8 @@ Poly::t Poly::exloop_join(t s1, t s2) {
 
 	// compute it
 	else {
-		r = allocate();
+		pair_t v[cap];
+		r = v;
 		int i = 0;
 
 		// join
@@ -446,7 +679,7 @@ Poly::t Poly::exloop_join(t s1, t s2) {
 					break;
 				}
 			}
-			else if(Dominance::dominates(p1->h, p2->h)) {
+			else if(precedes(p1->h, p2->h)) {
 				r[i++] = *p2;
 				//cerr << "DEBUG: -->  " << p1->c << " " << p1->h << " U " << p2->c << " " << p2->h << " = " << r[i - 1].c << ' ' << r[i - 1].h << io::endl;
 				p2++;
@@ -472,11 +705,14 @@ Poly::t Poly::exloop_join(t s1, t s2) {
 				//cerr << "DEBUG: +++ " << p2->c << " " << p2->h << io::endl;
 				p2++;
 			}
+			ASSERT(i < cap);
 			if(p1->c == p2->c)
 				r[i++] = *p1;
 			else
 				r = top;
 		}
+		if(r != top)
+			r = intern(v);
 	}
 
 	// return result
@@ -490,7 +726,7 @@ Poly::t Poly::widen(BasicBlock *h, t prev, t next) {
 		return next;
 	if(equals(prev, next))
 		return prev;
-	else if(next->h == h && equals(prev, next + 1))
+	else if(next->h == header(h) && same(prev, next + 1))
 		return next;
 	else
 		return top;
@@ -508,10 +744,10 @@ Poly::t Poly::loop_join(BasicBlock *h, t in, t back) {
 		return top;
 
 	// already loop-extended
-	if(back->h == h) {
+	if(back->h == header(h)) {
 		pair_t k(back->c, 0);
 		t nback = sub(back, &k);
-		if(!equals(nback + 1, in))
+		if(!same(nback + 1, in))
 			return top;
 		return nback;
 	}
@@ -520,24 +756,27 @@ Poly::t Poly::loop_join(BasicBlock *h, t in, t back) {
 	t k = sub(back, in);
 	if(k[0].h)
 		return top;
-	t r = allocate();
-	r[0] = pair_t(k[0].c, h);
-	int i;
-	for(i = 0; in[i].h; i++)
-		r[i + 1] = in [i];
-	r[i + 1] = in[i];
-	return r;
+	int n = 0;
+	while(in[n].h)
+		n++;
+	if(n + 2 > cap)		// no room for the new term
+		return top;
+	pair_t r[cap];
+	r[0] = pair_t(k[0].c, header(h));
+	for(int i = 0; i <= n; i++)
+		r[i + 1] = in[i];
+	return intern(r);
 }
 
 
 Poly::t Poly::filter(Edge *edge, t p) {
-	if(p[0].h != edge->source())
+	if(p[0].h != header(edge->source()))
 		return p;
-	int max = MAX_ITERATION(edge->source()),
-		min = MIN_ITERATION(edge->source());
+	int max = maxIteration(p[0].h),
+		min = minIteration(p[0].h);
 	if(max < 0 || max != min)
 		return top;
-	t r = allocate();
+	pair_t r[cap];
 	int i;
 	for(i = 1; p[i].h; i++)
 		r[i - 1] = p[i];
@@ -557,7 +796,7 @@ void Poly::dump(io::Output& out, t p) const {
 	else {
 		int i;
 		for(i = 0; p[i].h; i++)
-			out << p[i].c << " I" << p[i].h->number() << " + ";
+			out << p[i].c << " I" << (p[i].h - 1) << " + ";
 		out << "0x" << io::hex(p[i].c);
 	}
 }
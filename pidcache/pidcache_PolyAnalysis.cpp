@@ -43,7 +43,7 @@ Identifier<dfa::FastState<Poly>::t> PREV("", 0);
 class PolyAnalysis: public CFGProcessor {
 public:
 	static p::declare reg;
-	PolyAnalysis(p::declare& r = reg): CFGProcessor(r) { }
+	PolyAnalysis(p::declare& r = reg): CFGProcessor(r), man(0) { }
 
 protected:
 	typedef Poly::t value_t;
@@ -172,9 +172,14 @@ protected:
 #	endif
 	}
 
-	virtual void processCFG(WorkSpace *ws, CFG *cfg) {
-		PolyManager *man = new PolyManager(ws, cfg);
+	virtual void setup(WorkSpace *ws) {
+		// one manager (and one hash-consing table) shared by all CFGs:
+		// the values of different CFGs can then be compared by pointer
+		man = new PolyManager(ws);
+		POLY_MANAGER(ws) = man;
+	}
 
+	virtual void processCFG(WorkSpace *ws, CFG *cfg) {
 		// data initialization
 		ai::CFGGraph graph(cfg);
 		ai::EdgeStore<PolyManager, ai::CFGGraph> store(*man, graph);
@@ -224,9 +229,10 @@ protected:
 				s = widen(bb, *man, store);
 			POLY_STATE(bb) = s;
 		}
-		POLY_MANAGER(ws) = man;
 	}
 
+private:
+	PolyManager *man;
 };
 
 PolyManager::t PolyManager::update(Inst *i, sem::inst si, t s) {
@@ -435,12 +441,12 @@ BasicBlock *PolyManager::relativeTo(BasicBlock *bb, value_t r) const {
 	}
 
 	// lookup in the reference
-	BasicBlock *h = 0;
+	Poly::header_t h = 0;
 	while(r->h) {
 		h = r->h;
 		r++;
 	}
-	return h;
+	return _poly.block(h);
 }
 
 
@@ -462,14 +468,17 @@ Identifier<dfa::FastState<Poly>::t> POLY_STATE("otawa::pidcache::POLY_STATE", 0)
 
 /**
  * Manager to use result of the poly-analysis.
+ * The loop table of the domain covers all the CFGs of the workspace.
+ * @param ws	Current workspace.
  */
-PolyManager::PolyManager(WorkSpace *ws, CFG *cfg)
+PolyManager::PolyManager(WorkSpace *ws)
 : _poly(allocator),
   _state(&_poly, dfa::INITIAL_STATE(ws), allocator),
   tmps(new value_t[ws->process()->maxTemp()]),
   istate(dfa::INITIAL_STATE(ws))
 {
 	ASSERTP(istate, "no initial state available");
+	_poly.setLoops(**INVOLVED_CFGS(ws));
 	_init = _state.bot;
 
 	// initialize default stack address
@@ -21,11 +21,23 @@
 
 #include <otawa/hard/CacheConfiguration.h>
 #include <otawa/util/FlowFactLoader.h>
-#include <otawa/util/Dominance.h>
 #include "PIDCache.h"
 
 namespace otawa { namespace pidcache {
 
+/**
+ * Compute the greatest common divisor.
+ */
+template <class T>
+static T gcd(T a, T b) {
+	while(b) {
+		T r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
 /**
  * @class RefManager
  * This class provides facilities to handle the PI expressions.
@@ -69,7 +81,103 @@ bool RefManager::isCompatible(ref_t rr, ref_t tr) {
 
 /**
  */
-RefManager::~RefManager(void) { }
+RefManager::~RefManager(void) {
+	for(genstruct::HashTable<ref_t, info_t *>::Iterator i(infos); i; i++)
+		delete *i;
+}
+
+
+/**
+ * Build the index entry of a reference: the bitmap of the cache sets it
+ * may access, its address range and its count of blocks. Once indexed,
+ * @ref concerns() and @ref range() are answered from the index.
+ *
+ * As the index is not protected against concurrent modifications,
+ * the references must be indexed before starting analyses in parallel.
+ * @param r		Reference to index.
+ */
+void RefManager::index(ref_t r) {
+	if(r == Poly::top || r == Poly::bot || !r->h || infos.hasKey(r))
+		return;
+	info_t *i = new info_t(cache().setCount());
+
+	// compute the range
+	range(r, i->base, i->top);
+	i->blocks = cache().block(i->top) - cache().block(i->base) + 1;
+
+	// reference bigger than the cache (or unbounded): all sets
+	if(i->top - i->base >= address_t(1 << (cache().blockBits() + cache().setBits())))
+		for(int j = 0; j < cache().setCount(); j++)
+			i->sets.set(j);
+
+	// else compute the coverage
+	else
+		coverage(r, i->sets);
+	infos.put(r, i);
+}
+
+
+/**
+ * Compute the cache sets accessed by a reference. As the mapping of addresses
+ * to sets is periodic of period P = block size * set count, the residues
+ * modulo P of the reference are built term by term: a term c*i only
+ * produces P / gcd(c, P) different residues whatever its loop bound.
+ * The cost is then bounded by P instead of the iteration count.
+ * @param r		Reference (with loop terms, whose bounds are known).
+ * @param sets	Bit vector (one bit per set) to set the accessed sets in.
+ */
+void RefManager::coverage(ref_t r, BitVector& sets) {
+	address_t P = cache().blockSize() * cache().setCount();
+
+	// start from the base
+	ref_t p = r;
+	while(p->h)
+		p++;
+	BitVector seen(P);
+	genstruct::Vector<address_t> res, next;
+	res.add(address_t(p->c) & (P - 1));
+	seen.set(res[0]);
+
+	// add the terms
+	for(p = r; p->h && res.length() < int(P); p++) {
+		address_t c = address_t(p->c) & (P - 1);
+		int m = poly().maxIteration(p->h);
+		if(m < 0) {
+			for(int i = 0; i < cache().setCount(); i++)
+				sets.set(i);
+			return;
+		}
+		address_t n = min(address_t(max(m, 1)), c ? P / gcd(c, P) : 1);
+		next.clear();
+		for(int j = 0; j < res.length(); j++)
+			for(address_t i = 0, a = res[j]; i < n; i++, a = (a + c) & (P - 1))
+				if(!seen.bit(a)) {
+					seen.set(a);
+					next.add(a);
+				}
+		for(int j = 0; j < next.length(); j++)
+			res.add(next[j]);
+	}
+
+	// map residues to sets
+	for(int j = 0; j < res.length(); j++)
+		sets.set(res[j] >> cache().blockBits());
+}
+
+
+/**
+ * Get the number of cache blocks spanned by the address range of a reference.
+ * @param r		Reference to look at.
+ * @return		Number of blocks or -1 if the reference is not indexed.
+ */
+int RefManager::blockSpan(ref_t r) {
+	if(r == Poly::top || r == Poly::bot)
+		return -1;
+	if(!r->h)
+		return 1;
+	const info_t *i = info(r);
+	return i ? i->blocks : -1;
+}
 
 /**
  * @fn bool RefManager::sameSets(ref_t r1, ref_t r2);
@@ -100,10 +208,10 @@ RefManager::~RefManager(void) { }
 
 /**
  */
-RefManager::RefIter::RefIter(ref_t r): e(false), _failed(false), u(0) {
+RefManager::RefIter::RefIter(const Poly& poly, ref_t r): e(false), _failed(false), u(0) {
 	while(r->h) {
 		steps[u].i = 0;
-		steps[u].m = MAX_ITERATION(r->h);
+		steps[u].m = poly.maxIteration(r->h);
 		// ASSERT(steps[u].m != 0);
 		if(steps[u].m == -1) // if unbound
 			_failed = true;
@@ -158,7 +266,7 @@ RefManager::address_t RefManager::RefIter::apply(ref_t r) {
 
 /**
  */
-RefManager::CoRefIter::CoRefIter(ref_t r1, ref_t r2): e(false), _failed(false), u(0) {
+RefManager::CoRefIter::CoRefIter(const Poly& poly, ref_t r1, ref_t r2): e(false), _failed(false), u(0) {
 
 		// copy common
 		while(r1->h && r2->h) {
@@ -169,13 +277,13 @@ RefManager::CoRefIter::CoRefIter(ref_t r1, ref_t r2): e(false), _failed(false),
 				r1++;
 				r2++;
 			}
-			else if(Dominance::dominates(r1->h, r2->h)) {
+			else if(poly.precedes(r1->h, r2->h)) {
 				steps[u].c1 = 0;
 				steps[u].c2 = r2->c;
 				steps[u].h = r2->h;
 				r2++;
 			}
-			else if(Dominance::dominates(r2->h, r1->h)) {
+			else if(poly.precedes(r2->h, r1->h)) {
 				steps[u].c1 = r1->c;
 				steps[u].c2 = 0;
 				steps[u].h = r1->h;
@@ -188,7 +296,7 @@ RefManager::CoRefIter::CoRefIter(ref_t r1, ref_t r2): e(false), _failed(false),
 
 			// common init
 			steps[u].i = 0;
-			steps[u].m = MAX_ITERATION(steps[u].h);
+			steps[u].m = poly.maxIteration(steps[u].h);
 			if(steps[u].m == -1) {
 				_failed = true;
 				return;
@@ -237,22 +345,27 @@ public:
 
 	/**
 	 */
-	ExhaustiveRefManager(const hard::Cache& cache, const Poly& _poly): RefManager(cache), poly(_poly) { }
+	ExhaustiveRefManager(const hard::Cache& cache, const Poly& poly): RefManager(cache, poly) { }
 
 	/**
 	 */
 	virtual bool concerns(ref_t r, unsigned int set) {
 
 		// test basic cases
-		if(r == poly.top)
+		if(r == poly().top)
 			return true;
-		if(r == poly.bot)
+		if(r == poly().bot)
 			return false;
 
 		// r = simple constant
 		if(!r->h)
 			return cache().set(Address(r->c)) == set;
 
+		// indexed reference
+		const info_t *i = info(r);
+		if(i)
+			return i->sets.bit(set);
+
 		// size bigger than cache
 		address_t base, top;
 		range(r, base, top);
@@ -262,7 +375,7 @@ public:
 		// test on sets
 		elm::t::uint32 base_set = cache().set(Address(base));
 		elm::t::uint32 top_set = cache().set(Address(top));
-		// cerr << "DEBUG: "; poly.dump(cerr, r); cerr << " -> [" << Address(base) << ", " << Address(top) << "]: [" << base_set << ", " << top_set << "]\n";
+		// cerr << "DEBUG: "; poly().dump(cerr, r); cerr << " -> [" << Address(base) << ", " << Address(top) << "]: [" << base_set << ", " << top_set << "]\n";
 		if(base_set <= top_set) {
 			if(set < base_set || top_set < set)
 				return false;
@@ -270,46 +383,10 @@ public:
 		else if(base_set < set && set < top_set)
 			return false;
 
-		// prepare enumeration
-		typedef struct {
-			int i;
-			int m;
-			coef_t c;
-		} step_t;
-		static const int max_step = 16;
-		step_t steps[max_step];
-		int n = 0;
-		ref_t p;
-		for(p = r; p->h; p++) {
-			steps[n].i = 0;
-			steps[n].m = MAX_ITERATION(p->h);
-			if(steps[n].m < 0)
-				return true;
-			steps[n].c = p->c;
-			n++;
-		}
-
-		// enumerate all the values
-		while(true) {
-
-			// test the value
-			address_t a = p->c;
-			for(int i = 0; i < n; i++)
-				a += steps[i].c * steps[i].i;
-			//cerr << "DEBUG: concern is testing " << cache->set(a) << io::endl;
-			if(cache().set(Address(a)) == set)
-				return true;
-
-			// increment
-			steps[0].i++;
-			for(int i = 0; steps[i].i >= steps[i].m; i++) {
-				steps[i].i = 0;
-				if(i == n - 1)
-					return false;
-				steps[i + 1].i++;
-			}
-		}
-		return false;
+		// closed-form coverage
+		BitVector sets(cache().setCount());
+		coverage(r, sets);
+		return sets.bit(set);
 	}
 
 	/**
@@ -317,13 +394,13 @@ public:
 	virtual bool mayMeet(ref_t r1, int gen1, ref_t r2, int gen2) {
 
 		// process top and bot
-		if(r1 == poly.top || r2 == poly.top)
+		if(r1 == poly().top || r2 == poly().top)
 			return true;
-		if(r1 == poly.bot || r2 == poly.bot)
+		if(r1 == poly().bot || r2 == poly().bot)
 			return false;
 
 		// simple equality
-		if(poly.equals(r1, r2)) {
+		if(poly().equals(r1, r2)) {
 			if(gen1 == gen2)
 				return true;
 			else
@@ -343,7 +420,7 @@ public:
 
 		// prepare the traversal
 		typedef struct {
-			BasicBlock *h;
+			Poly::header_t h;
 			address_t c1, c2;
 			int f, m, i;
 		} step_t;
@@ -357,22 +434,22 @@ public:
 				steps[n].h = p1->h;
 				steps[n].c1 = p1->c;
 				steps[n].c2 = p2->c;
-				steps[n].m = MAX_ITERATION(p1->h);
+				steps[n].m = poly().maxIteration(p1->h);
 				p1++;
 				p2++;
 			}
-			else if(!p1->h || (p2->h && Dominance::dominates(p1->h, p2->h))) {
+			else if(!p1->h || (p2->h && poly().precedes(p1->h, p2->h))) {
 				steps[n].h = p2->h;
 				steps[n].c1 = 0;
 				steps[n].c2 = p2->c;
-				steps[n].m = MAX_ITERATION(p2->h);
+				steps[n].m = poly().maxIteration(p2->h);
 				p2++;
 			}
 			else {
 				steps[n].h = p1->h;
 				steps[n].c1 = p1->c;
 				steps[n].c2 = 0;
-				steps[n].m = MAX_ITERATION(p1->h);
+				steps[n].m = poly().maxIteration(p1->h);
 				p1++;
 			}
 			total *= steps[n].m;
@@ -395,7 +472,7 @@ public:
 		while(true) {
 
 			// perform the test
-			address_t a1 = 0, a2 = 0;
+			address_t a1 = p1->c, a2 = p2->c;
 			for(int i = 0; i < n; i++) {
 				a1 += steps[i].c1 * steps[i].i;
 				a2 += steps[i].c2 * steps[i].i;
@@ -419,17 +496,17 @@ public:
 	virtual bool sameSets(ref_t r1, ref_t r2) {
 
 		// process top and bot
-		if(r1 == poly.top || r2 == poly.top)
+		if(r1 == poly().top || r2 == poly().top)
 			return false;
-		if(r1 == poly.bot || r2 == poly.bot)
+		if(r1 == poly().bot || r2 == poly().bot)
 			return false;
 
 		// simple equality
-		if(poly.equals(r1, r2))
+		if(poly().equals(r1, r2))
 			return true;
 
 		// test all values
-		CoRefIter i(r1, r2);
+		CoRefIter i(poly(), r1, r2);
 		if(i.failed())
 			return false;
 		for(; i; i++)
@@ -441,17 +518,17 @@ public:
 	virtual bool sameBlocks(ref_t r1, ref_t r2) {
 
 		// process top and bot
-		if(r1 == poly.top || r2 == poly.top)
+		if(r1 == poly().top || r2 == poly().top)
 			return false;
-		if(r1 == poly.bot || r2 == poly.bot)
+		if(r1 == poly().bot || r2 == poly().bot)
 			return false;
 
 		// simple equality
-		if(poly.equals(r1, r2))
+		if(poly().equals(r1, r2))
 			return true;
 
 		// test all values
-		CoRefIter i(r1, r2);
+		CoRefIter i(poly(), r1, r2);
 		if(i.failed())
 			return false;
 		for(; i; i++)
@@ -468,9 +545,19 @@ public:
 	 * @param top	Return top address (exclusive).
 	 */
 	virtual void range(ref_t r, address_t& base, address_t& top) {
+
+		// indexed reference
+		const info_t *i = r->h ? info(r) : 0;
+		if(i) {
+			base = i->base;
+			top = i->top;
+			return;
+		}
+
+		// compute it
 		top = 0;
 		while(r->h) {
-			int max = otawa::MAX_ITERATION(r->h);
+			int max = poly().maxIteration(r->h);
 			if(max == -1) {
 				// if loop bounds could not be determined
 				// set range to [0,+inf[
@@ -489,11 +576,129 @@ public:
 			top = tmp;
 		}
 	}
+};
 
 
-private:
+/**
+ * Reference manager deciding @ref mayMeet() arithmetically for affine
+ * references. The difference of both addresses d(i) = k + sum e_j * i_j is
+ * bounded on the iteration space and its values are congruent to k modulo
+ * the GCD of the e_j: if no such value lies in ]-block size, block size[,
+ * the references cannot meet. Such a value does not imply that both addresses
+ * are in the same block: when only one loop makes the addresses vary,
+ * the iterations giving such a value are few and their blocks are compared.
+ * Other cases are resolved by the enumeration of ExhaustiveRefManager.
+ */
+class AffineRefManager: public ExhaustiveRefManager {
+public:
+	typedef t::int64 val_t;
 
-	const Poly& poly;
+	/**
+	 */
+	AffineRefManager(const hard::Cache& cache, const Poly& poly): ExhaustiveRefManager(cache, poly) { }
+
+	/**
+	 */
+	virtual bool mayMeet(ref_t r1, int gen1, ref_t r2, int gen2) {
+
+		// process top and bot
+		if(r1 == poly().top || r2 == poly().top)
+			return true;
+		if(r1 == poly().bot || r2 == poly().bot)
+			return false;
+
+		// simple equality
+		if(poly().equals(r1, r2)) {
+			if(gen1 == gen2)
+				return true;
+			else
+				return r1->c < cache().blockSize();
+		}
+
+		// compute the bounds of d and the GCD of the varying coefficients
+		// (with the coefficients of the varying loop, shared if a loop moves both addresses alike)
+		ref_t p1 = r1, p2 = r2;
+		val_t lo = 0, hi = 0, g = 0, c1 = 0, c2 = 0;
+		int n = 0, mv = 0;
+		bool shared = false;
+		while(p1->h || p2->h) {
+			val_t a = 0, b = 0;
+			Poly::header_t h;
+			if(p1->h == p2->h) {
+				a = p1->c;
+				b = p2->c;
+				h = p1->h;
+				p1++;
+				p2++;
+			}
+			else if(!p1->h || (p2->h && poly().precedes(p1->h, p2->h))) {
+				b = p2->c;
+				h = p2->h;
+				p2++;
+			}
+			else {
+				a = p1->c;
+				h = p1->h;
+				p1++;
+			}
+			val_t e = a - b;
+			int m = poly().maxIteration(h);
+			if(m < 0)
+				return true;
+			if(m <= 1)
+				continue;
+			if(e == 0) {
+				shared = true;
+				continue;
+			}
+			if(e < 0)
+				lo += e * (m - 1);
+			else
+				hi += e * (m - 1);
+			g = gcd(g, e < 0 ? -e : e);
+			c1 = a;
+			c2 = b;
+			mv = m;
+			n++;
+		}
+		val_t k = val_t(address_t(p1->c)) - val_t(address_t(p2->c));
+		lo += k;
+		hi += k;
+
+		// constant difference
+		if(!n) {
+			if(!r1->h && !r2->h)
+				return cache().block(address_t(p1->c)) == cache().block(address_t(p2->c));
+			return k > -val_t(cache().blockSize()) && k < val_t(cache().blockSize());
+		}
+
+		// look for a value of d congruent to k in ]-block size, block size[
+		val_t xlo = max(lo, 1 - val_t(cache().blockSize())),
+			  xhi = min(hi, val_t(cache().blockSize()) - 1);
+		if(xlo > xhi)
+			return false;
+		val_t x = xlo + ((k - xlo) % g + g) % g;
+		if(x > xhi)
+			return false;
+
+		// one varying loop: compare the blocks of the iterations giving d in [xlo, xhi]
+		if(n == 1 && !shared) {
+			val_t e = c1 - c2, ae = e < 0 ? -e : e;
+			val_t u = e > 0 ? xlo - k : k - xhi, v = e > 0 ? xhi - k : k - xlo;
+			val_t ilo = max(val_t(0), ceilDiv(u, ae)), ihi = min(val_t(mv - 1), floorDiv(v, ae));
+			for(val_t i = ilo; i <= ihi; i++)
+				if(cache().block(address_t(p1->c) + address_t(c1 * i)) == cache().block(address_t(p2->c) + address_t(c2 * i)))
+					return true;
+			return false;
+		}
+		return ExhaustiveRefManager::mayMeet(r1, gen1, r2, gen2);
+	}
+
+private:
+	static inline val_t floorDiv(val_t a, val_t b)
+		{ val_t q = a / b; return a % b != 0 && a < 0 ? q - 1 : q; }
+	static inline val_t ceilDiv(val_t a, val_t b)
+		{ val_t q = a / b; return a % b != 0 && a > 0 ? q + 1 : q; }
 };
 
 
@@ -502,16 +707,27 @@ private:
 class L1RefManagerBuilder: public Processor {
 public:
 	static p::declare reg;
-	L1RefManagerBuilder(p::declare& r = reg): Processor(reg) { }
+	L1RefManagerBuilder(p::declare& r = reg): Processor(reg), affine(false) { }
+
+	virtual void configure(const PropList& props) {
+		Processor::configure(props);
+		affine = AFFINE_REF_MANAGER(props);
+	}
+
 protected:
 
 	virtual void processWorkSpace(WorkSpace *ws) {
 		const hard::CacheConfiguration *conf = hard::CACHE_CONFIGURATION(ws);
 		if(!conf->dataCache())
 			throw ProcessorException(*this, "no data cache available");
-		REF_MANAGER(ws) = new ExhaustiveRefManager(*(conf->dataCache()), POLY_MANAGER(ws)->poly());
+		if(affine)
+			REF_MANAGER(ws) = new AffineRefManager(*(conf->dataCache()), POLY_MANAGER(ws)->poly());
+		else
+			REF_MANAGER(ws) = new ExhaustiveRefManager(*(conf->dataCache()), POLY_MANAGER(ws)->poly());
 	}
 
+private:
+	bool affine;
 };
 
 p::declare L1RefManagerBuilder::reg = p::init("otawa::pidcache::L1RefManagerBuilder", Version(1, 0, 0))
@@ -527,6 +743,8 @@ p::declare L1RefManagerBuilder::reg = p::init("otawa::pidcache::L1RefManagerBuil
  * @p Properties
  * @li @ref REF_MANAGER;
  *
+ * @p Configuration
+ * @li @ref AFFINE_REF_MANAGER
  */
 p::feature REF_MANAGER_FEATURE("otawa::pidcache::REF_MANAGER_FEATURE", new Maker<L1RefManagerBuilder>());
 
@@ -543,5 +761,16 @@ p::feature REF_MANAGER_FEATURE("otawa::pidcache::REF_MANAGER_FEATURE", new Maker
 Identifier<RefManager *> REF_MANAGER("otawa::pidcache::REF_MANAGER", 0);
 
 
+/**
+ * Configuration property asking the @ref REF_MANAGER_FEATURE to provide
+ * a reference manager testing the meeting of affine references
+ * arithmetically instead of enumerating their iteration space.
+ *
+ * @p Features
+ * @li @ref REF_MANAGER_FEATURE
+ */
+Identifier<bool> AFFINE_REF_MANAGER("otawa::pidcache::AFFINE_REF_MANAGER", false);
+
+
 } }	// otawa::pidcache
 
@@ -0,0 +1,185 @@
+/*
+ *	pidcache::Scheduler class
+ *
+ *	This file is part of OTAWA
+ *	Copyright (c) 2014, IRIT UPS.
+ *
+ *	OTAWA is free software; you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation; either version 2 of the License, or
+ *	(at your option) any later version.
+ *
+ *	OTAWA is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with OTAWA; if not, write to the Free Software
+ *	Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <elm/util/MessageException.h>
+#include "Scheduler.h"
+
+namespace otawa { namespace pidcache {
+
+/**
+ * @class Scheduler
+ * Work-stealing scheduler running a set of independent tasks
+ * on a fixed number of threads. The tasks are first distributed
+ * in contiguous slices over the workers: a worker consumes its own
+ * slice from the end and, when it is empty, steals the first task
+ * of the slice of another worker.
+ *
+ * With only one job, the tasks are run in the calling thread,
+ * in the order they have been added.
+ */
+
+/**
+ * @class Scheduler::Task
+ * A task run by the scheduler. A task must not modify data shared
+ * with other tasks: its results have to be stored in the task itself
+ * and used after Scheduler::run() returns.
+ */
+
+/**
+ */
+Scheduler::Task::~Task(void) { }
+
+
+// Worker class
+class Scheduler::Worker: public sys::Runnable {
+public:
+	Worker(Scheduler& scheduler, int low, int high)
+		: sched(scheduler), lo(low), hi(high), failed(false), thread(0), mutex(sys::Mutex::make()) { }
+	~Worker(void) { delete thread; delete mutex; }
+
+	virtual void run(void) {
+		try {
+			while(true) {
+				Task *task = pop();
+				if(!task)
+					task = sched.steal(this);
+				if(!task)
+					break;
+				task->run();
+			}
+		}
+		catch(elm::Exception& e) {
+			failed = true;
+			msg = e.message();
+		}
+		catch(...) {
+			failed = true;
+			msg = "unexpected exception in a scheduler task";
+		}
+	}
+
+	Task *pop(void) {
+		Task *task = 0;
+		mutex->lock();
+		if(lo < hi)
+			task = sched.tasks[--hi];
+		mutex->unlock();
+		return task;
+	}
+
+	Task *take(void) {
+		Task *task = 0;
+		mutex->lock();
+		if(lo < hi)
+			task = sched.tasks[lo++];
+		mutex->unlock();
+		return task;
+	}
+
+	Scheduler& sched;
+	int lo, hi;
+	bool failed;
+	string msg;
+	sys::Thread *thread;
+	sys::Mutex *mutex;
+};
+
+
+/**
+ * Build a scheduler.
+ * @param jobs	Number of threads to use (less than 1 is considered as 1).
+ */
+Scheduler::Scheduler(int jobs): _jobs(jobs < 1 ? 1 : jobs) {
+}
+
+/**
+ */
+Scheduler::~Scheduler(void) {
+	for(int i = 0; i < workers.length(); i++)
+		delete workers[i];
+}
+
+
+/**
+ * @fn int Scheduler::jobs(void) const;
+ * Get the number of threads used by the scheduler.
+ * @return	Number of threads.
+ */
+
+
+/**
+ * Add a task to run. The task is not deleted by the scheduler.
+ * @param task	Added task.
+ */
+void Scheduler::add(Task *task) {
+	tasks.add(task);
+}
+
+
+/**
+ * Run all the added tasks and wait for their end.
+ * @throw MessageException	If one of the tasks has failed.
+ */
+void Scheduler::run(void) {
+
+	// simple case: serial execution
+	if(_jobs == 1 || tasks.length() <= 1) {
+		for(int i = 0; i < tasks.length(); i++)
+			tasks[i]->run();
+		return;
+	}
+
+	// distribute the tasks
+	int n = min(_jobs, tasks.length());
+	for(int i = 0; i < n; i++)
+		workers.add(new Worker(*this, i * tasks.length() / n, (i + 1) * tasks.length() / n));
+
+	// launch the workers
+	for(int i = 0; i < n; i++) {
+		workers[i]->thread = sys::Thread::make(*workers[i]);
+		workers[i]->thread->start();
+	}
+
+	// wait for the end
+	for(int i = 0; i < n; i++)
+		workers[i]->thread->join();
+	for(int i = 0; i < n; i++)
+		if(workers[i]->failed)
+			throw MessageException(workers[i]->msg);
+}
+
+
+/**
+ * Look for a task to steal from the other workers.
+ * @param thief		Worker looking for a task.
+ * @return			Stolen task or null if there is no more task.
+ */
+Scheduler::Task *Scheduler::steal(Worker *thief) {
+	for(int i = 0; i < workers.length(); i++)
+		if(workers[i] != thief) {
+			Task *task = workers[i]->take();
+			if(task)
+				return task;
+		}
+	return 0;
+}
+
+} }	// otawa::pidcache